@@ -0,0 +1,406 @@
+// cvec benchmarks: push_back, erase, free and allocation counts.
+//
+// Build and run from the repository root with pinned flags:
+//
+//   make bench
+//
+// An optional argument scales every case (./cvec_bench 4 runs 4x the work).
+// Each case runs a fixed number of times on fixed data and the fastest run is
+// reported, so two builds on the same machine can be compared directly.
+// Columns:
+//   ns/op    wall time per element operation
+//   bytes/op bytes requested from the allocator per operation
+//   allocs   allocator calls (alloc + realloc + free) for one run
+//            ("-" for cases on the default malloc/realloc path, which
+//            cannot be counted; their "counted" twin has the numbers)
+//   peak KiB peak RSS of the case, every case runs in its own forked process
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include "cvec.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_RUNS 5
+
+
+// Counting allocator, wraps malloc and records every call
+typedef struct
+{
+    uint64_t calls;
+    uint64_t bytes;
+} bench_counter;
+
+static void* bench_alloc(void* ctx, size_t sz)
+{
+    bench_counter* counter = (bench_counter*)ctx;
+
+    counter->calls++;
+    counter->bytes += sz;
+
+    return malloc(sz);
+}
+
+static void* bench_realloc(void* ctx, void* ptr, size_t old_sz, size_t new_sz)
+{
+    bench_counter* counter = (bench_counter*)ctx;
+
+    counter->calls++;
+    if(new_sz > old_sz)
+        counter->bytes += new_sz;
+
+    return realloc(ptr, new_sz);
+}
+
+static void bench_free(void* ctx, void* ptr, size_t sz)
+{
+    bench_counter* counter = (bench_counter*)ctx;
+
+    (void)sz;
+    counter->calls++;
+
+    free(ptr);
+}
+
+
+// Timing and reporting helpers
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static long bench_peak_rss_kib(void)
+{
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+typedef struct
+{
+    uint64_t ns;
+    uint64_t ops;
+    bench_counter counter;
+    int32_t  uncounted;     // ran on the default allocator
+    long     peak_kib;
+} bench_result;
+
+static void bench_report(const char* name, const bench_result* result)
+{
+    double ops = result->ops ? (double)result->ops : 1.0;
+
+    if(result->uncounted)
+    {
+        printf("%-40s %10.2f %10s %10s %10ld\n", name,
+               (double)result->ns / ops, "-", "-", result->peak_kib);
+        return ;
+    }
+
+    printf("%-40s %10.2f %10.2f %10llu %10ld\n", name,
+           (double)result->ns / ops,
+           (double)result->counter.bytes / ops,
+           (unsigned long long)result->counter.calls,
+           result->peak_kib);
+}
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile uint64_t bench_sink;
+
+
+// A case runs once per call and fills its result
+typedef void (*bench_case_fn)(const void* params, uint64_t scale, bench_result* result);
+
+static void bench_run_case(bench_case_fn fn, const void* params, uint64_t scale, bench_result* best)
+{
+    memset(best, 0, sizeof(*best));
+
+    for(int run = 0; run < BENCH_RUNS; run++)
+    {
+        bench_result result;
+        memset(&result, 0, sizeof(result));
+
+        fn(params, scale, &result);
+
+        if(run == 0 || result.ns < best->ns)
+            *best = result;
+    }
+
+    best->peak_kib = bench_peak_rss_kib();
+}
+
+// ru_maxrss never drops, so each case runs in a fresh child and sends its
+// result back through a pipe. The parent only allocates what it prints.
+static void bench_run(const char* name, bench_case_fn fn, const void* params, uint64_t scale)
+{
+    bench_result best;
+    memset(&best, 0, sizeof(best));
+
+    int fds[2];
+    if(pipe(fds) != 0)
+    {
+        fprintf(stderr, "%s: pipe failed\n", name);
+        return ;
+    }
+
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        fprintf(stderr, "%s: fork failed\n", name);
+        close(fds[0]);
+        close(fds[1]);
+        return ;
+    }
+
+    if(pid == 0)
+    {
+        close(fds[0]);
+        bench_run_case(fn, params, scale, &best);
+
+        int32_t ok = write(fds[1], &best, sizeof(best)) == (ssize_t)sizeof(best);
+        _exit(ok ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    ssize_t got = read(fds[0], &best, sizeof(best));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    if(got != (ssize_t)sizeof(best) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "%s: case failed\n", name);
+        return ;
+    }
+
+    bench_report(name, &best);
+}
+
+
+// push_back throughput for one element size and growth policy
+typedef struct
+{
+    size_t             elem_sz;
+    cvec_growth_policy growth;
+    int32_t            counted;     // counting allocator instead of malloc/realloc
+} bench_push_params;
+
+static void bench_push_back(const void* params, uint64_t scale, bench_result* result)
+{
+    const bench_push_params* p = (const bench_push_params*)params;
+
+    uint64_t count = (4000000ull / p->elem_sz) * scale;
+
+    cvec_allocator allocator = { &result->counter, bench_alloc, bench_realloc, bench_free };
+
+    cvec_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.growth    = p->growth;
+    opts.allocator = p->counted ? &allocator : NULL;
+
+    result->uncounted = !p->counted;
+
+    uint8_t elem[256];
+    memset(elem, 0x5a, sizeof(elem));
+
+    uint64_t start = bench_now_ns();
+
+    void* vec = cvec_create_ex(p->elem_sz, NULL, &opts);
+    for(uint64_t i = 0; i < count; i++)
+    {
+        elem[0] = (uint8_t)i;
+        vec = cvec_push_back(vec, elem);
+    }
+
+    bench_sink = cvec_get_sz(vec);
+    cvec_free(vec);
+
+    result->ns  = bench_now_ns() - start;
+    result->ops = count;
+}
+
+
+// erase at the front, middle or back until the vector is empty
+typedef enum
+{
+    BENCH_ERASE_FRONT,
+    BENCH_ERASE_MIDDLE,
+    BENCH_ERASE_BACK
+} bench_erase_where;
+
+static void bench_erase(const void* params, uint64_t scale, bench_result* result)
+{
+    bench_erase_where where = *(const bench_erase_where*)params;
+
+    uint64_t count = 20000ull * scale;
+
+    cvec_allocator allocator = { &result->counter, bench_alloc, bench_realloc, bench_free };
+
+    cvec_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.allocator = &allocator;
+
+    uint64_t* vec = (uint64_t*)cvec_reserve_ex(count, sizeof(uint64_t), NULL, &opts);
+    for(uint64_t i = 0; i < count; i++)
+        vec = (uint64_t*)cvec_push_back(vec, &i);
+
+    result->counter.calls = 0;
+    result->counter.bytes = 0;
+
+    uint64_t start = bench_now_ns();
+
+    for(uint64_t left = count; left > 0; left--)
+    {
+        size_t index = (where == BENCH_ERASE_FRONT)  ? 0 :
+                       (where == BENCH_ERASE_MIDDLE) ? (size_t)(left / 2) : (size_t)(left - 1);
+        cvec_erase(vec, index);
+    }
+
+    result->ns  = bench_now_ns() - start;
+    result->ops = count;
+
+    // Only the erases are counted
+    bench_counter counted = result->counter;
+    cvec_free(vec);
+    result->counter = counted;
+}
+
+
+// free a vector of owned strings, per element or range destructor or none
+typedef enum
+{
+    BENCH_FREE_NONE,
+    BENCH_FREE_ELEM,
+    BENCH_FREE_RANGE
+} bench_free_kind;
+
+static void bench_free_elem(void* elem)
+{
+    free(*(char**)elem);
+}
+
+static void bench_free_range(void* first, size_t count)
+{
+    char** strings = (char**)first;
+
+    for(size_t i = 0; i < count; i++)
+        free(strings[i]);
+}
+
+static void bench_free_vec(const void* params, uint64_t scale, bench_result* result)
+{
+    bench_free_kind kind = *(const bench_free_kind*)params;
+
+    uint64_t count = 500000ull * scale;
+
+    cvec_allocator allocator = { &result->counter, bench_alloc, bench_realloc, bench_free };
+
+    cvec_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.allocator        = &allocator;
+    opts.range_destructor = (kind == BENCH_FREE_RANGE) ? bench_free_range : NULL;
+
+    char** vec = (char**)cvec_reserve_ex(count, sizeof(char*),
+                                         (kind == BENCH_FREE_ELEM) ? bench_free_elem : NULL, &opts);
+
+    // Without a destructor the strings are released after the timed part
+    char** owned = (kind == BENCH_FREE_NONE) ? (char**)malloc(count * sizeof(char*)) : NULL;
+
+    for(uint64_t i = 0; i < count; i++)
+    {
+        char* str = (char*)malloc(24);
+        snprintf(str, 24, "%llu", (unsigned long long)i);
+        vec = (char**)cvec_push_back(vec, &str);
+
+        if(owned)
+            owned[i] = str;
+    }
+
+    result->counter.calls = 0;
+    result->counter.bytes = 0;
+
+    uint64_t start = bench_now_ns();
+    cvec_free(vec);
+    result->ns  = bench_now_ns() - start;
+    result->ops = count;
+
+    if(owned)
+    {
+        for(uint64_t i = 0; i < count; i++)
+            free(owned[i]);
+        free(owned);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    uint64_t scale = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1;
+    if(scale == 0)
+        scale = 1;
+
+    printf("%-40s %10s %10s %10s %10s\n", "case", "ns/op", "bytes/op", "allocs", "peak KiB");
+
+    static const size_t elem_sizes[] = { 4, 16, 64, 256 };
+
+    struct
+    {
+        const char*        name;
+        cvec_growth_policy growth;
+    } policies[3];
+
+    policies[0].name = "x2";       policies[0].growth = cvec_growth_factor(200);
+    policies[1].name = "x1.5";     policies[1].growth = cvec_growth_factor(150);
+    policies[2].name = "+4096";    policies[2].growth = cvec_growth_chunk(4096);
+
+    for(size_t s = 0; s < sizeof(elem_sizes) / sizeof(elem_sizes[0]); s++)
+    {
+        for(size_t g = 0; g < sizeof(policies) / sizeof(policies[0]); g++)
+        {
+            for(int32_t counted = 0; counted <= 1; counted++)
+            {
+                bench_push_params params = { elem_sizes[s], policies[g].growth, counted };
+
+                char name[64];
+                snprintf(name, sizeof(name), "push_back %3zuB growth %s%s",
+                         elem_sizes[s], policies[g].name, counted ? " counted" : "");
+
+                bench_run(name, bench_push_back, &params, scale);
+            }
+        }
+    }
+
+    bench_erase_where front  = BENCH_ERASE_FRONT;
+    bench_erase_where middle = BENCH_ERASE_MIDDLE;
+    bench_erase_where back   = BENCH_ERASE_BACK;
+
+    bench_run("erase front",  bench_erase, &front,  scale);
+    bench_run("erase middle", bench_erase, &middle, scale);
+    bench_run("erase back",   bench_erase, &back,   scale);
+
+    bench_free_kind none  = BENCH_FREE_NONE;
+    bench_free_kind elem  = BENCH_FREE_ELEM;
+    bench_free_kind range = BENCH_FREE_RANGE;
+
+    bench_run("free no destructor",    bench_free_vec, &none,  scale);
+    bench_run("free elem destructor",  bench_free_vec, &elem,  scale);
+    bench_run("free range destructor", bench_free_vec, &range, scale);
+
+    return 0;
+}
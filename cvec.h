@@ -23,12 +23,84 @@
 #ifndef CVEC_H_
 #define CVEC_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Blocks of at least CVEC_MMAP_THRESHOLD bytes move to anonymous mappings
+// (0 = never, the default). It must be an integer constant usable in #if.
+// Only vectors on the default allocator are affected.
+// CVEC_ENABLE_MAP_FILE compiles in cvec_map_file. With neither of them, or
+// with CVEC_NO_MMAP, no mmap header is included.
+#if !defined(CVEC_MMAP_THRESHOLD)
+#define CVEC_MMAP_THRESHOLD 0
+#endif
+
+#if !defined(CVEC_NO_MMAP) && (defined(__unix__) || defined(__APPLE__)) && \
+    (CVEC_MMAP_THRESHOLD > 0 || defined(CVEC_ENABLE_MAP_FILE))
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(MAP_ANONYMOUS)
+#define CVEC_HAS_MMAP
+#define INTERNAL_CVEC_MAP_ANON MAP_ANONYMOUS
+#elif defined(MAP_ANON)
+#define CVEC_HAS_MMAP
+#define INTERNAL_CVEC_MAP_ANON MAP_ANON
+#endif
+
+// Anonymous growth copies without mremap, so on Linux it is required: called
+// through syscall() when _GNU_SOURCE is not defined. Mapped files remap
+// without copying either way.
+#if defined(CVEC_HAS_MMAP) && defined(__linux__)
+#if defined(MREMAP_MAYMOVE)
+#define INTERNAL_CVEC_MREMAP(base, old_len, new_len) mremap((base), (old_len), (new_len), MREMAP_MAYMOVE)
+#elif CVEC_MMAP_THRESHOLD > 0
+#include <sys/syscall.h>
+#if defined(SYS_mremap) && (defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE))
+// MREMAP_MAYMOVE is 1 in the kernel ABI
+#define INTERNAL_CVEC_MREMAP(base, old_len, new_len) \
+    ((void*)syscall(SYS_mremap, (base), (size_t)(old_len), (size_t)(new_len), 1))
+#else
+#error "cvec: no mremap in strict ISO mode, define _GNU_SOURCE (or CVEC_NO_MMAP) before any include"
+#endif
+#endif
+#endif
+
+// Anonymous mmap backing for large vectors
+#if defined(CVEC_HAS_MMAP) && CVEC_MMAP_THRESHOLD > 0
+#define INTERNAL_CVEC_MMAP_GROWTH
+#elif CVEC_MMAP_THRESHOLD > 0
+#error "cvec: CVEC_MMAP_THRESHOLD needs MAP_ANONYMOUS, define _GNU_SOURCE (or CVEC_NO_MMAP) before any include"
+#endif
+#endif
+
+// cvec_write_fd / cvec_read_fd need POSIX descriptors and writev
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CVEC_HAS_FD_IO
+#endif
+
+// SIMD kernels are picked at compile time, define CVEC_NO_SIMD to force scalar code
+#if !defined(CVEC_NO_SIMD)
+#if defined(__AVX2__)
+#define CVEC_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CVEC_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CVEC_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 // Internal memory management funcs
 #ifndef INTERNAL_CVEC_FREE
 #define INTERNAL_CVEC_FREE free
@@ -50,15 +122,391 @@
 // typedef of destructor
 typedef void (*cvec_elem_destructor)(void* elem);
 
+// Destroys count contiguous elements starting at first in one call
+typedef void (*cvec_range_destructor)(void* first, size_t count);
+
+// typedef of growth callback, returns the new capacity for a vector
+// that needs to hold at least required elements
+typedef uint64_t (*cvec_growth_fn)(uint64_t capacity, uint64_t required);
+
+// How a vector grows once it runs out of capacity
+typedef enum
+{
+    CVEC_GROWTH_FACTOR = 0,   // capacity * param / 100 (<= 100 means doubling)
+    CVEC_GROWTH_CHUNK,        // capacity + param elements
+    CVEC_GROWTH_CALLBACK      // fn(capacity, required)
+} cvec_growth_kind;
+
+typedef struct
+{
+    cvec_growth_kind kind;
+    uint64_t         param;
+    cvec_growth_fn   fn;
+} cvec_growth_policy;
+
+// Per-vector allocator, ctx is handed back to every call.
+// Sizes are the full block sizes so arena/pool allocators can track them.
+typedef struct
+{
+    void* ctx;
+
+    void* (*alloc_fn)  (void* ctx, size_t sz);
+    void* (*realloc_fn)(void* ctx, void* ptr, size_t old_sz, size_t new_sz);
+    void  (*free_fn)   (void* ctx, void* ptr, size_t sz);
+} cvec_allocator;
+
+// Vector flags
+#define CVEC_FLAG_NO_ZERO_INIT (1u << 0)   // leave reserved/grown capacity uninitialized
+#define CVEC_FLAG_INLINE       (1u << 1)   // storage is a caller buffer (set by cvec_init_inline)
+#define CVEC_FLAG_HUGEPAGE     (1u << 2)   // ask for transparent huge pages on mmap backed storage
+#define CVEC_FLAG_MMAP         (1u << 3)   // storage is an anonymous mapping (set on growth)
+#define CVEC_FLAG_FILE         (1u << 4)   // storage is a mapped file (set by cvec_map_file)
+#define CVEC_FLAG_READONLY     (1u << 5)   // mapped file is read-only, growth fails
+#define CVEC_FLAG_DEQUE        (1u << 6)   // data is a ring starting at head (set by cvec_deque_*)
+
+// Optional creation hints for cvec_reserve_ex, zero-init for defaults
+typedef struct
+{
+    cvec_growth_policy    growth;
+    uint32_t              flags;
+    const cvec_allocator* allocator;   // NULL for INTERNAL_CVEC_* (must outlive the vector)
+    uint32_t              alignment;   // data alignment in bytes, power of two (0 for default)
+    cvec_range_destructor range_destructor; // used instead of the per element destructor when set
+} cvec_options;
+
+// Per vector counters, only filled in when built with CVEC_STATS defined.
+// Off by default: the hooks then expand to nothing and the header keeps its size.
+typedef struct
+{
+    const char* tag;                // label for cvec_stats_dump, see cvec_stats_set_tag
+    uint64_t    reallocs;           // capacity changes that went to the allocator or mmap
+    uint64_t    growth_copy_bytes;  // live bytes that moved with the block
+    uint64_t    memset_bytes;       // bytes zeroed on growth, resize and emplace
+    uint64_t    memmove_bytes;      // bytes shifted by erase, insert and splice
+    uint64_t    peak_capacity;
+} cvec_stats;
+
 typedef struct
 {
     uint64_t size;        
     uint64_t capacity;
     uint64_t typesize;
 
-    cvec_elem_destructor destructor;
+    cvec_elem_destructor  destructor;
+    cvec_range_destructor range_destructor;   // takes over from destructor when set
+    uint64_t              head;               // first element of a CVEC_FLAG_DEQUE ring
+
+    uint64_t       growth_param;
+    cvec_growth_fn growth_fn;
+    uint32_t       growth_kind;
+    uint32_t       flags;
+
+    const cvec_allocator* allocator;
+
+    // Aligned vectors over-allocate by alignment - 1 bytes,
+    // the metadata sits offset bytes into the allocated block
+    uint32_t alignment;
+    uint32_t offset;
+
+    // keeps the header a multiple of 16 bytes so data stays max aligned
+    uint64_t reserved_;
+
+#if defined(CVEC_STATS)
+    // Part of the header, so cvec_map_file files are specific to the build mode
+    cvec_stats stats;
+#endif
 } internal_cvec_metadata_ ;
 
+// Stats hooks, kept defined after this header since CVEC_DEFINE code uses them
+#if defined(CVEC_STATS)
+#define INTERNAL_CVEC_STAT_ADD(meta, field, n) ((meta)->stats.field += (uint64_t)(n))
+#define INTERNAL_CVEC_STAT_PEAK(meta, cap)                                          \
+    ((meta)->stats.peak_capacity = ((uint64_t)(cap) > (meta)->stats.peak_capacity)  \
+                                 ? (uint64_t)(cap) : (meta)->stats.peak_capacity)
+#else
+#define INTERNAL_CVEC_STAT_ADD(meta, field, n) ((void)0)
+#define INTERNAL_CVEC_STAT_PEAK(meta, cap)     ((void)0)
+#endif
+
+
+// cvec files start with this stamp, followed at data_offset - sizeof(internal_cvec_metadata_)
+// by an image of the metadata (size/capacity/typesize) and then the raw data
+#define CVEC_FILE_MAGIC   "CVECFILE"
+#define CVEC_FILE_VERSION 1u
+#define CVEC_FILE_ENDIAN  0x01020304u
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian;        // CVEC_FILE_ENDIAN as written by the host
+    uint64_t data_offset;
+    uint32_t meta_size;     // sizeof(internal_cvec_metadata_), differs with CVEC_STATS
+    uint32_t reserved;
+
+    // runtime only, meaningless on disk
+    int64_t  fd;
+    uint64_t map_len;
+} cvec_file_header;
+
+// cvec_write_fd streams start with this header, followed by size * typesize bytes
+#define CVEC_STREAM_MAGIC "CVECSTRM"
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;       // CVEC_FILE_VERSION
+    uint32_t endian;        // CVEC_FILE_ENDIAN as written by the host
+    uint64_t typesize;
+    uint64_t size;
+} cvec_stream_header;
+
+
+// Function form of INTERNAL_CVEC_GET_METADATA, usable from macro generated code
+static inline
+internal_cvec_metadata_* internal_cvec_meta_(const void* vec)
+{
+    return (internal_cvec_metadata_*)((uint8_t*)(vec) - sizeof(internal_cvec_metadata_));
+}
+
+
+// Rounds x up to a multiple of align (a power of two)
+static inline
+uint64_t internal_cvec_align_up_(uint64_t x, uint64_t align)
+{
+    return (x + (align - 1)) & ~(align - 1);
+}
+
+// Returns the largest capacity whose block size still fits a size_t
+static inline
+uint64_t internal_cvec_max_capacity_(uint64_t elem_sz, uint32_t alignment)
+{
+    uint64_t slack = alignment ? alignment - 1 : 0;
+    uint64_t room  = (uint64_t)SIZE_MAX - sizeof(internal_cvec_metadata_) - slack;
+
+    return elem_sz ? room / elem_sz : room;
+}
+
+// Returns a + b, or UINT64_MAX when the sum wraps (no capacity fits that)
+static inline
+uint64_t internal_cvec_add_sat_(uint64_t a, uint64_t b)
+{
+    return (b > UINT64_MAX - a) ? UINT64_MAX : a + b;
+}
+
+// Returns the size of the block backing capacity elements,
+// capacity must not exceed internal_cvec_max_capacity_
+static inline
+uint64_t internal_cvec_block_sz_(const internal_cvec_metadata_* meta__, uint64_t capacity)
+{
+    uint64_t slack = meta__->alignment ? meta__->alignment - 1 : 0;
+
+    return sizeof(internal_cvec_metadata_) + slack + capacity * meta__->typesize;
+}
+
+// Returns the start of the block backing the vector
+static inline
+uint8_t* internal_cvec_block_base_(internal_cvec_metadata_* meta__)
+{
+    return (uint8_t*)meta__ - meta__->offset;
+}
+
+// Returns where the metadata must go in a block at base so the data is aligned
+static inline
+uint32_t internal_cvec_block_offset_(const void* base, uint32_t alignment)
+{
+    if(alignment == 0)
+        return 0;
+
+    uint64_t data = (uint64_t)(uintptr_t)base + sizeof(internal_cvec_metadata_);
+
+    return (uint32_t)(internal_cvec_align_up_(data, alignment) - data);
+}
+
+
+#if defined(CVEC_HAS_MMAP)
+// Returns bytes rounded up to whole pages
+static inline
+uint64_t internal_cvec_map_len_(uint64_t bytes)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    return internal_cvec_align_up_(bytes, (page > 0) ? (uint64_t)page : 4096);
+}
+
+static inline
+void internal_cvec_map_advise_(void* base, uint64_t len, uint32_t flags)
+{
+#if defined(MADV_HUGEPAGE)
+    if(flags & CVEC_FLAG_HUGEPAGE)
+        madvise(base, len, MADV_HUGEPAGE);
+#else
+    (void)base; (void)len; (void)flags;
+#endif
+}
+
+#if defined(INTERNAL_CVEC_MMAP_GROWTH)
+// Maps len zeroed bytes
+static inline
+void* internal_cvec_map_(uint64_t len, uint32_t flags)
+{
+    void* base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | INTERNAL_CVEC_MAP_ANON, -1, 0);
+    if(base == MAP_FAILED)
+        return (NULL);
+
+    internal_cvec_map_advise_(base, len, flags);
+
+    return base;
+}
+
+// Resizes a mapping, keeping its first keep bytes. Pages are moved, not copied, with mremap.
+static inline
+void* internal_cvec_remap_(void* base, uint64_t old_len, uint64_t new_len, uint64_t keep, uint32_t flags)
+{
+#if defined(INTERNAL_CVEC_MREMAP)
+    (void)keep;
+
+    void* moved = INTERNAL_CVEC_MREMAP(base, old_len, new_len);
+    if(moved == MAP_FAILED)
+        return (NULL);
+
+    internal_cvec_map_advise_(moved, new_len, flags);
+
+    return moved;
+#else
+    void* moved = internal_cvec_map_(new_len, flags);
+    if(!moved)
+        return (NULL);
+
+    memcpy(moved, base, keep);
+    munmap(base, old_len);
+
+    return moved;
+#endif
+}
+#endif
+
+// Resizes a writable mapped file to new_capacity elements, extending or
+// truncating the file. Returns the new metadata or NULL on failure.
+static inline
+internal_cvec_metadata_* internal_cvec_file_resize_(internal_cvec_metadata_* meta__, uint64_t new_capacity)
+{
+    if(meta__->flags & CVEC_FLAG_READONLY)
+        return (NULL);
+
+    cvec_file_header* header = (cvec_file_header*)internal_cvec_block_base_(meta__);
+
+    int      fd        = (int)header->fd;
+    uint32_t offset    = meta__->offset;
+    uint64_t capacity  = meta__->capacity;
+    uint64_t old_len   = header->map_len;
+    uint64_t new_bytes = offset + internal_cvec_block_sz_(meta__, new_capacity);
+    uint64_t new_len   = internal_cvec_map_len_(new_bytes);
+
+    // The extended part of the file reads back as zero
+    if(new_capacity > capacity && ftruncate(fd, (off_t)new_bytes) != 0)
+        return (NULL);
+
+#if defined(INTERNAL_CVEC_MREMAP)
+    void* base = INTERNAL_CVEC_MREMAP(header, old_len, new_len);
+    if(base == MAP_FAILED)
+        return (NULL);
+#else
+    // Map the new view before dropping the old one, the file holds the data
+    void* base = mmap(NULL, new_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED)
+        return (NULL);
+
+    munmap(header, old_len);
+#endif
+
+    // Shrinking the file is best effort, a longer file only wastes disk space
+    if(new_capacity < capacity)
+        (void)!ftruncate(fd, (off_t)new_bytes);
+
+    ((cvec_file_header*)base)->map_len = new_len;
+
+    return (internal_cvec_metadata_*)((uint8_t*)base + offset);
+}
+#endif
+
+// Returns whether a block for capacity elements should be mmap backed
+static inline
+int32_t internal_cvec_wants_map_(const internal_cvec_metadata_* meta__, uint64_t capacity)
+{
+#if defined(INTERNAL_CVEC_MMAP_GROWTH)
+    if(meta__->flags & CVEC_FLAG_MMAP)
+        return 1;
+
+    return !meta__->allocator && !(meta__->flags & CVEC_FLAG_INLINE) &&
+           internal_cvec_block_sz_(meta__, capacity) >= (uint64_t)CVEC_MMAP_THRESHOLD;
+#else
+    (void)meta__; (void)capacity;
+    return 0;
+#endif
+}
+
+
+// Allocation helpers, dispatch to the vector's allocator or the INTERNAL_CVEC_* funcs
+static inline
+void* internal_cvec_mem_alloc_(const cvec_allocator* allocator, size_t sz, int32_t zero)
+{
+    if(!allocator)
+        return zero ? INTERNAL_CVEC_CALLOC(1, sz) : INTERNAL_CVEC_MALLOC(sz);
+
+    void* ptr = allocator->alloc_fn(allocator->ctx, sz);
+    if(ptr && zero)
+        memset(ptr, 0, sz);
+
+    return ptr;
+}
+
+static inline
+void* internal_cvec_mem_realloc_(const cvec_allocator* allocator, void* ptr, size_t old_sz, size_t new_sz)
+{
+    if(!allocator)
+        return INTERNAL_CVEC_REALLOC(ptr, new_sz);
+
+    return allocator->realloc_fn(allocator->ctx, ptr, old_sz, new_sz);
+}
+
+static inline
+void internal_cvec_mem_free_(const cvec_allocator* allocator, void* ptr, size_t sz)
+{
+    if(!allocator)
+    {
+        INTERNAL_CVEC_FREE(ptr);
+        return ;
+    }
+
+    allocator->free_fn(allocator->ctx, ptr, sz);
+}
+
+
+// Grow by a factor given in percent (150 = 1.5x)
+static inline
+cvec_growth_policy cvec_growth_factor(uint64_t percent)
+{
+    cvec_growth_policy policy = { CVEC_GROWTH_FACTOR, percent, NULL };
+    return policy;
+}
+
+// Grow by a fixed number of elements
+static inline
+cvec_growth_policy cvec_growth_chunk(uint64_t elems)
+{
+    cvec_growth_policy policy = { CVEC_GROWTH_CHUNK, elems, NULL };
+    return policy;
+}
+
+// Grow by asking fn for the new capacity
+static inline
+cvec_growth_policy cvec_growth_callback(cvec_growth_fn fn)
+{
+    cvec_growth_policy policy = { CVEC_GROWTH_CALLBACK, 0, fn };
+    return policy;
+}
+
 
 // Returns the vector's capacity
 static inline 
@@ -96,126 +544,4786 @@ int32_t cvec_empty(const void* vec)
     return (cvec_get_sz(vec) == 0);
 }
 
-// Returns a vector with reserved space
+// Changes the growth policy of an existing vector
 static inline
-void* cvec_reserve(size_t capacity, 
-                   size_t elem_sz,
-                   cvec_elem_destructor destructor)
+void cvec_set_growth_policy(void* vec, cvec_growth_policy policy)
 {
-    uint64_t new_allocated_size__  = sizeof(internal_cvec_metadata_) + capacity * elem_sz;
-
-    void* vec__ = INTERNAL_CVEC_MALLOC(new_allocated_size__);
-    memset(vec__, 0, new_allocated_size__);
-
-    internal_cvec_metadata_* meta__ = (internal_cvec_metadata_*) vec__;
+    if(!vec) return ;
 
-    meta__->capacity   = capacity;
-    meta__->typesize   = elem_sz;
-    meta__->destructor = destructor;
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
 
-    return ((uint8_t*)vec__ + sizeof(internal_cvec_metadata_));
+    meta__->growth_kind  = (uint32_t)policy.kind;
+    meta__->growth_param = policy.param;
+    meta__->growth_fn    = policy.fn;
 }
 
-// Returns a vector with capacity of 1
+// Sets a destructor called once per contiguous span of destroyed elements.
+// While set it is used instead of the per element destructor (NULL restores it).
 static inline
-void* cvec_create(size_t elem_sz,
-                  cvec_elem_destructor destructor)
+void cvec_set_range_destructor(void* vec, cvec_range_destructor destructor)
 {
-    return cvec_reserve(1,elem_sz,destructor);
-}
+    if(!vec) return ;
 
+    INTERNAL_CVEC_GET_METADATA(vec)->range_destructor = destructor;
+}
 
-// Push back an element in the vector
+// Returns a vector with reserved space, configured by opts (may be NULL)
 static inline
-void* cvec_push_back(void* vec , const void* elem)
+void* cvec_reserve_ex(size_t capacity,
+                      size_t elem_sz,
+                      cvec_elem_destructor destructor,
+                      const cvec_options* opts)
 {
-    if(!vec)
+    uint32_t flags__               = opts ? opts->flags : 0;
+    const cvec_allocator* alloc__  = opts ? opts->allocator : NULL;
+    uint32_t alignment__           = opts ? opts->alignment : 0;
+
+    // Alignment must be a power of two
+    if(alignment__ & (alignment__ - 1))
         return (NULL);
 
-    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    // The block size must not wrap
+    if(capacity > internal_cvec_max_capacity_(elem_sz, alignment__))
+        return (NULL);
 
-    uint64_t               sz         = meta__->size;
-    uint64_t               capacity   = meta__->capacity;
-    uint64_t               elem_sz    = meta__->typesize;
-    cvec_elem_destructor destructor = meta__->destructor;
+    uint64_t new_allocated_size__  = sizeof(internal_cvec_metadata_) + capacity * elem_sz
+                                   + (alignment__ ? alignment__ - 1 : 0);
 
-    if(capacity == sz)
-    {
-        uint64_t new_capacity = (capacity == 0) ? 1 : capacity*2;
-        meta__ = (internal_cvec_metadata_*)
-                 INTERNAL_CVEC_REALLOC(meta__,
-                                        sizeof(internal_cvec_metadata_) + new_capacity * elem_sz);
+    // Fresh pages from calloc are already zero, only clear the header otherwise
+    int32_t zero__ = !(flags__ & CVEC_FLAG_NO_ZERO_INIT);
 
-        // reset the memory to 0 after a point
-        vec = meta__ + 1;
-        memset((uint8_t*)vec + capacity, 0, (new_capacity - capacity) * elem_sz);
+    void* vec__ = NULL;
 
-        meta__->capacity = new_capacity;
+#if defined(INTERNAL_CVEC_MMAP_GROWTH)
+    // Big enough from the start, mapped pages are zero already
+    if(!alloc__ && new_allocated_size__ >= (uint64_t)CVEC_MMAP_THRESHOLD)
+    {
+        vec__ = internal_cvec_map_(internal_cvec_map_len_(new_allocated_size__), flags__);
+        if(vec__)
+        {
+            flags__ |= CVEC_FLAG_MMAP;
+            zero__   = 1;
+        }
     }
+#endif
 
-    memcpy((uint8_t*)vec + (sz * elem_sz), elem, elem_sz);
-    meta__->size++;
-
-    return vec;
-}
+    if(!vec__)
+        vec__ = internal_cvec_mem_alloc_(alloc__, new_allocated_size__, zero__);
 
+    if(!vec__)
+        return (NULL);
 
-// Erase an element from the vector
-static inline
-void cvec_erase(void* vec, size_t index)
-{    
-    if(!vec) return ;
+    uint32_t offset__ = internal_cvec_block_offset_(vec__, alignment__);
 
-    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    internal_cvec_metadata_* meta__ = (internal_cvec_metadata_*)((uint8_t*)vec__ + offset__);
+    if(!zero__)
+        memset(meta__, 0, sizeof(internal_cvec_metadata_));
 
-    uint64_t               sz         = meta__->size;
-    uint64_t               capacity   = meta__->capacity;
-    uint64_t               elem_sz    = meta__->typesize;
-    cvec_elem_destructor destructor = meta__->destructor;
+    meta__->capacity   = capacity;
+    meta__->typesize   = elem_sz;
+    meta__->destructor = destructor;
+    meta__->flags      = flags__;
+    meta__->allocator  = alloc__;
+    meta__->alignment  = alignment__;
+    meta__->offset     = offset__;
 
-    uint8_t* data = (uint8_t*)vec;
+    if(opts)
+        meta__->range_destructor = opts->range_destructor;
 
-    // If out of bounds, do not erase anything
-    if(index >= sz) return ;
+    INTERNAL_CVEC_STAT_PEAK(meta__, capacity);
 
-    if (destructor) {
-        destructor(data + index * elem_sz);
-    }
+    if(opts)
+        cvec_set_growth_policy(meta__ + 1, opts->growth);
 
-    // Shift elements
-    memmove(data + index * elem_sz,
-            data + (index + 1)  * elem_sz,
-            (sz -  (index + 1)) * elem_sz);
+    return (meta__ + 1);
+}
 
-    meta__->size--;
-    
-    return ;
+// Returns a vector with reserved space
+static inline
+void* cvec_reserve(size_t capacity, 
+                   size_t elem_sz,
+                   cvec_elem_destructor destructor)
+{
+    return cvec_reserve_ex(capacity, elem_sz, destructor, NULL);
 }
 
-// Free the vector and its metadata
+// Returns a vector whose data (not the metadata) is aligned to alignment bytes,
+// a power of two. The alignment is kept across growth.
 static inline
-void cvec_free(void* vec)
+void* cvec_reserve_aligned(size_t capacity,
+                           size_t elem_sz,
+                           size_t alignment,
+                           cvec_elem_destructor destructor)
 {
-    if(!vec) return ;
+    cvec_options opts__;
+    memset(&opts__, 0, sizeof(opts__));
 
-    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    opts__.alignment = (uint32_t)alignment;
 
-    uint64_t               sz         = meta__->size;
-    uint64_t               elem_sz    = meta__->typesize;
-    cvec_elem_destructor destructor = meta__->destructor;
+    return cvec_reserve_ex(capacity, elem_sz, destructor, &opts__);
+}
 
-    if(destructor)
-    {
-        uint8_t* data = (uint8_t*) vec;
+// Storage for a small-buffer vector holding N elements of T without a heap
+// allocation, e.g. `CVEC_INLINE(int, 4) buf;` on the stack. See cvec_init_inline.
+// The long double member aligns the buffer like malloc, so the data (a multiple
+// of 16 bytes past the start) is as aligned as on the heap path.
+#define CVEC_INLINE(T, N)\
+    union { internal_cvec_metadata_ meta; long double align; uint8_t bytes[sizeof(internal_cvec_metadata_) + (N) * sizeof(T)]; }
 
-        for(uint64_t i = 0; i < sz; i++)
+// Returns a vector living in the caller provided buffer (usually a CVEC_INLINE).
+// It spills to the heap once it outgrows the buffer; cvec_free never frees the
+// buffer itself, so it must outlive the vector while it is still inline.
+static inline
+void* cvec_init_inline(void* buf, size_t buf_sz,
+                       size_t elem_sz,
+                       cvec_elem_destructor destructor)
+{
+    if(!buf || buf_sz < sizeof(internal_cvec_metadata_) || elem_sz == 0)
+        return (NULL);
+
+    memset(buf, 0, buf_sz);
+
+    internal_cvec_metadata_* meta__ = (internal_cvec_metadata_*) buf;
+
+    meta__->capacity   = (buf_sz - sizeof(internal_cvec_metadata_)) / elem_sz;
+    meta__->typesize   = elem_sz;
+    meta__->destructor = destructor;
+    meta__->flags      = CVEC_FLAG_INLINE;
+
+    INTERNAL_CVEC_STAT_PEAK(meta__, meta__->capacity);
+
+    return meta__ + 1;
+}
+
+// Returns a vector with capacity of 1
+static inline
+void* cvec_create(size_t elem_sz,
+                  cvec_elem_destructor destructor)
+{
+    return cvec_reserve(1,elem_sz,destructor);
+}
+
+// Returns a vector with capacity of 1, configured by opts (may be NULL)
+static inline
+void* cvec_create_ex(size_t elem_sz,
+                     cvec_elem_destructor destructor,
+                     const cvec_options* opts)
+{
+    return cvec_reserve_ex(1,elem_sz,destructor,opts);
+}
+
+
+// Runs the destructor on count elements starting at first,
+// the range destructor gets the whole span in one call
+static inline
+void internal_cvec_destroy_range_(const internal_cvec_metadata_* meta__, uint8_t* data,
+                                  uint64_t first, uint64_t count)
+{
+    cvec_elem_destructor destructor = meta__->destructor;
+    uint64_t             elem_sz    = meta__->typesize;
+
+    if(meta__->range_destructor)
+    {
+        if(count)
+            meta__->range_destructor(data + first*elem_sz, (size_t)count);
+        return ;
+    }
+
+    if(!destructor) return ;
+
+    for(uint64_t i = first; i < first + count; i++)
+        destructor(data + i*elem_sz);
+}
+
+
+// Destroys every element, following the ring of a deque
+static inline
+void internal_cvec_destroy_all_(const internal_cvec_metadata_* meta__, uint8_t* data)
+{
+    if(!(meta__->flags & CVEC_FLAG_DEQUE))
+    {
+        internal_cvec_destroy_range_(meta__, data, 0, meta__->size);
+        return ;
+    }
+
+    uint64_t head  = meta__->head;
+    uint64_t first = (meta__->size < meta__->capacity - head) ? meta__->size : meta__->capacity - head;
+
+    internal_cvec_destroy_range_(meta__, data, head, first);
+    internal_cvec_destroy_range_(meta__, data, 0, meta__->size - first);
+}
+
+
+// Returns the capacity the growth policy picks for holding required elements
+static inline
+uint64_t internal_cvec_next_capacity_(const internal_cvec_metadata_* meta__, uint64_t required)
+{
+    uint64_t capacity     = meta__->capacity;
+    uint64_t param        = meta__->growth_param;
+    uint64_t new_capacity = 0;
+
+    switch(meta__->growth_kind)
+    {
+        case CVEC_GROWTH_CHUNK:
+            new_capacity = capacity + (param ? param : 1);
+            break;
+
+        case CVEC_GROWTH_CALLBACK:
+            new_capacity = meta__->growth_fn ? meta__->growth_fn(capacity, required) : 0;
+            break;
+
+        case CVEC_GROWTH_FACTOR:
+        default:
+            if(param <= 100) param = 200;
+            new_capacity = (capacity / 100) * param + ((capacity % 100) * param) / 100;
+            break;
+    }
+
+    if(new_capacity <= capacity)
+        new_capacity = capacity + 1;
+
+    // Clamp the policy so a too large step does not fail a request that fits
+    uint64_t max_capacity = internal_cvec_max_capacity_(meta__->typesize, meta__->alignment);
+    if(new_capacity > max_capacity)
+        new_capacity = max_capacity;
+
+    return (new_capacity < required) ? required : new_capacity;
+}
+
+
+// Reallocates the vector to exactly new_capacity elements (new_capacity >= size).
+// Returns the (possibly moved) vector, or NULL if the reallocation failed
+// (the original vector is left untouched).
+static inline
+void* internal_cvec_set_capacity_(void* vec, uint64_t new_capacity)
+{
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t capacity = meta__->capacity;
+    uint64_t elem_sz  = meta__->typesize;
+
+    // Every path below sizes a block from new_capacity
+    if(new_capacity > internal_cvec_max_capacity_(elem_sz, meta__->alignment))
+        return (NULL);
+
+#if defined(CVEC_STATS)
+    uintptr_t old_data = (uintptr_t)vec;
+    uint64_t  live     = ((meta__->size < new_capacity) ? meta__->size : new_capacity) * elem_sz;
+#endif
+
+#if defined(CVEC_HAS_MMAP)
+    if(meta__->flags & CVEC_FLAG_FILE)
+    {
+        meta__ = internal_cvec_file_resize_(meta__, new_capacity);
+        if(!meta__)
+            return (NULL);
+
+        // File extension is zero already
+        capacity = (new_capacity > capacity) ? new_capacity : capacity;
+    }
+    else
+#endif
+    if(meta__->flags & CVEC_FLAG_INLINE)
+    {
+        // Inline buffers never shrink, they spill to the heap once outgrown
+        if(new_capacity <= capacity)
+            return vec;
+
+        uint8_t* base__ = (uint8_t*)
+            internal_cvec_mem_alloc_(meta__->allocator, internal_cvec_block_sz_(meta__, new_capacity), 0);
+        if(!base__)
+            return (NULL);
+
+        uint32_t offset__ = internal_cvec_block_offset_(base__, meta__->alignment);
+
+        internal_cvec_metadata_* spilled__ = (internal_cvec_metadata_*)(base__ + offset__);
+
+        memcpy(spilled__, meta__, sizeof(internal_cvec_metadata_) + meta__->size * elem_sz);
+        spilled__->flags &= ~CVEC_FLAG_INLINE;
+        spilled__->offset = offset__;
+
+        // Treat the copied span as the old capacity for the zero-fill below
+        capacity = meta__->size;
+        meta__   = spilled__;
+    }
+#if defined(INTERNAL_CVEC_MMAP_GROWTH)
+    else if(internal_cvec_wants_map_(meta__, new_capacity))
+    {
+        uint32_t flags__      = meta__->flags;
+        uint32_t alignment__  = meta__->alignment;
+        uint32_t old_offset__ = meta__->offset;
+        uint64_t kept         = (new_capacity < capacity) ? new_capacity : capacity;
+        uint64_t keep_bytes   = old_offset__ + sizeof(internal_cvec_metadata_) + kept * elem_sz;
+        uint64_t new_len      = internal_cvec_map_len_(internal_cvec_block_sz_(meta__, new_capacity));
+        uint8_t* old_base     = internal_cvec_block_base_(meta__);
+        uint8_t* base__       = NULL;
+
+        if(flags__ & CVEC_FLAG_MMAP)
+        {
+            uint64_t old_len = internal_cvec_map_len_(internal_cvec_block_sz_(meta__, capacity));
+
+            // Bytes past the capacity must stay zero in the pages we keep
+            if(new_capacity < capacity)
+            {
+                uint64_t end = keep_bytes < new_len ? keep_bytes : new_len;
+                memset(old_base + end, 0, new_len - end);
+            }
+
+            base__ = (uint8_t*)internal_cvec_remap_(old_base, old_len, new_len, keep_bytes, flags__);
+            if(!base__)
+                return (NULL);
+        }
+        else
+        {
+            // Crossing the threshold: one last copy out of the heap
+            base__ = (uint8_t*)internal_cvec_map_(new_len, flags__);
+            if(!base__)
+                return (NULL);
+
+            memcpy(base__, old_base, keep_bytes);
+            internal_cvec_mem_free_(NULL, old_base, internal_cvec_block_sz_(meta__, capacity));
+        }
+
+        uint32_t offset__ = internal_cvec_block_offset_(base__, alignment__);
+        if(offset__ != old_offset__)
+        {
+            uint64_t span = sizeof(internal_cvec_metadata_) + kept * elem_sz;
+
+            memmove(base__ + offset__, base__ + old_offset__, span);
+
+            // Sliding down leaves copied bytes past the span, the tail must read as zero
+            if(offset__ < old_offset__)
+                memset(base__ + offset__ + span, 0, old_offset__ - offset__);
+        }
+
+        meta__ = (internal_cvec_metadata_*)(base__ + offset__);
+        meta__->offset = offset__;
+        meta__->flags |= CVEC_FLAG_MMAP;
+
+        // Fresh pages are zero already
+        capacity = (new_capacity > capacity) ? new_capacity : capacity;
+    }
+#endif
+    else
+    {
+        uint32_t alignment__  = meta__->alignment;
+        uint32_t old_offset__ = meta__->offset;
+
+        uint8_t* base__ = (uint8_t*)
+                 internal_cvec_mem_realloc_(meta__->allocator, internal_cvec_block_base_(meta__),
+                                            internal_cvec_block_sz_(meta__, capacity),
+                                            internal_cvec_block_sz_(meta__, new_capacity));
+        if(!base__)
+            return (NULL);
+
+        // realloc keeps the bytes, not the alignment: slide header and data back in place
+        uint32_t offset__ = internal_cvec_block_offset_(base__, alignment__);
+        if(offset__ != old_offset__)
+        {
+            uint64_t kept = (new_capacity < capacity) ? new_capacity : capacity;
+
+            memmove(base__ + offset__, base__ + old_offset__,
+                    sizeof(internal_cvec_metadata_) + kept * elem_sz);
+        }
+
+        meta__ = (internal_cvec_metadata_*)(base__ + offset__);
+        meta__->offset = offset__;
+    }
+
+    // reset the memory to 0 after a point
+    vec = meta__ + 1;
+    if(new_capacity > capacity && !(meta__->flags & CVEC_FLAG_NO_ZERO_INIT))
+    {
+        memset((uint8_t*)vec + capacity * elem_sz, 0, (new_capacity - capacity) * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memset_bytes, (new_capacity - capacity) * elem_sz);
+    }
+
+    meta__->capacity = new_capacity;
+
+#if defined(CVEC_STATS)
+    INTERNAL_CVEC_STAT_ADD(meta__, reallocs, 1);
+    INTERNAL_CVEC_STAT_PEAK(meta__, new_capacity);
+    if((uintptr_t)vec != old_data)
+        INTERNAL_CVEC_STAT_ADD(meta__, growth_copy_bytes, live);
+#endif
+
+    return vec;
+}
+
+
+// Grows the vector so it can hold at least min_capacity elements.
+// Performs at most one reallocation, see internal_cvec_set_capacity_.
+static inline
+void* internal_cvec_grow_(void* vec, uint64_t min_capacity)
+{
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(min_capacity <= meta__->capacity)
+        return vec;
+
+    // Also guards cvec_resize and the bulk inserts, a wrapped block would be tiny
+    if(min_capacity > internal_cvec_max_capacity_(meta__->typesize, meta__->alignment))
+        return (NULL);
+
+    return internal_cvec_set_capacity_(vec, internal_cvec_next_capacity_(meta__, min_capacity));
+}
+
+
+// Make room for at least additional more elements with at most one reallocation.
+// Returns the (possibly moved) vector, or NULL on failure like cvec_push_back.
+static inline
+void* cvec_grow(void* vec, size_t additional)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    // A ring is not contiguous, see cvec_deque_linearize
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    if(meta__->capacity - meta__->size >= additional)
+        return vec;
+
+    // size + additional must not wrap
+    if(additional > UINT64_MAX - meta__->size)
+        return (NULL);
+
+    return internal_cvec_set_capacity_(vec, meta__->size + additional);
+}
+
+
+// Resize the vector to new_sz elements.
+// Removed elements are destroyed, new ones are copies of fill_elem (zeroed if NULL).
+static inline
+void* cvec_resize(void* vec, size_t new_sz, const void* fill_elem)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    if(new_sz <= sz)
+    {
+        internal_cvec_destroy_range_(meta__, (uint8_t*)vec, new_sz, sz - new_sz);
+        meta__->size = new_sz;
+        return vec;
+    }
+
+    // fill_elem may point into the vector itself
+    uintptr_t fill_offset = (uintptr_t)fill_elem - (uintptr_t)vec;
+    int32_t   aliased     = fill_elem && ((uintptr_t)fill_elem >= (uintptr_t)vec) &&
+                            (fill_offset < sz * elem_sz);
+
+    vec = internal_cvec_grow_(vec, new_sz);
+    if(!vec)
+        return (NULL);
+
+    if(aliased)
+        fill_elem = (uint8_t*)vec + fill_offset;
+
+    meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint8_t* tail  = (uint8_t*)vec + sz * elem_sz;
+    uint64_t count = new_sz - sz;
+
+    if(!fill_elem)
+    {
+        memset(tail, 0, count * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memset_bytes, count * elem_sz);
+    }
+    else
+    {
+        // Seed one element then double the filled span
+        memcpy(tail, fill_elem, elem_sz);
+        for(uint64_t filled = 1; filled < count; filled *= 2)
+        {
+            uint64_t n = (filled < count - filled) ? filled : count - filled;
+            memcpy(tail + filled * elem_sz, tail, n * elem_sz);
+        }
+    }
+
+    meta__->size = new_sz;
+
+    return vec;
+}
+
+
+// Push back an element in the vector
+static inline
+void* cvec_push_back(void* vec , const void* elem)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    if(meta__->capacity == sz)
+    {
+        vec = internal_cvec_grow_(vec, sz + 1);
+        if(!vec)
+            return (NULL);
+
+        meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    memcpy((uint8_t*)vec + (sz * elem_sz), elem, elem_sz);
+    meta__->size++;
+
+    return vec;
+}
+
+
+// Push back count contiguous elements from src in the vector.
+// Capacity is grown once for the whole batch and the elements are copied
+// with a single memcpy.
+static inline
+void* cvec_push_back_n(void* vec, const void* src, size_t count)
+{
+    if(!vec)
+        return (NULL);
+
+    if(count == 0 || !src)
+        return vec;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    if(meta__->capacity - sz < count)
+    {
+        // src may point into the vector itself (e.g. self-append)
+        uintptr_t src_offset = (uintptr_t)src - (uintptr_t)vec;
+        int32_t   aliased    = ((uintptr_t)src >= (uintptr_t)vec) && (src_offset < sz * elem_sz);
+
+        vec = internal_cvec_grow_(vec, internal_cvec_add_sat_(sz, count));
+        if(!vec)
+            return (NULL);
+
+        if(aliased)
+            src = (uint8_t*)vec + src_offset;
+
+        meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    memcpy((uint8_t*)vec + (sz * elem_sz), src, count * elem_sz);
+    meta__->size += count;
+
+    return vec;
+}
+
+
+// Append count new slots and return a pointer to the first one so the caller
+// can construct the elements in place. vec_ptr is the address of the vector
+// variable (e.g. &vec) and is updated if the vector moves. The slots are zeroed
+// unless the vector was created with CVEC_FLAG_NO_ZERO_INIT.
+// Returns NULL on failure, leaving the vector untouched.
+static inline
+void* cvec_emplace_back_n(void* vec_ptr, size_t count)
+{
+    void** pvec__ = (void**)vec_ptr;
+
+    if(!pvec__ || !*pvec__)
+        return (NULL);
+
+    void* vec = *pvec__;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    if(meta__->capacity - sz < count)
+    {
+        vec = internal_cvec_grow_(vec, internal_cvec_add_sat_(sz, count));
+        if(!vec)
+            return (NULL);
+
+        *pvec__ = vec;
+        meta__  = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    uint8_t* slot = (uint8_t*)vec + sz * elem_sz;
+
+    if(!(meta__->flags & CVEC_FLAG_NO_ZERO_INIT))
+    {
+        memset(slot, 0, count * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memset_bytes, count * elem_sz);
+    }
+
+    meta__->size += count;
+
+    return slot;
+}
+
+
+// Append one new slot, see cvec_emplace_back_n
+static inline
+void* cvec_emplace_back(void* vec_ptr)
+{
+    return cvec_emplace_back_n(vec_ptr, 1);
+}
+
+
+// Append every element of src at the end of dst.
+// Both vectors must have the same type size, otherwise dst is returned as is.
+static inline
+void* cvec_append(void* dst, const void* src)
+{
+    if(!dst)
+        return (NULL);
+
+    if(cvec_get_type_sz(dst) != cvec_get_type_sz(src))
+        return dst;
+
+    return cvec_push_back_n(dst, src, cvec_get_sz(src));
+}
+
+
+// Insert count contiguous elements from src before index.
+// Capacity is grown at most once and the tail is moved with a single memmove;
+// src may point into the vector itself. If index is out of bounds nothing is
+// inserted. Returns the (possibly moved) vector, or NULL on failure like
+// cvec_push_back.
+static inline
+void* cvec_insert_n(void* vec, size_t index, const void* src, size_t count)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    if(count == 0 || !src || index > sz)
+        return vec;
+
+    uintptr_t src_offset = (uintptr_t)src - (uintptr_t)vec;
+    int32_t   aliased    = ((uintptr_t)src >= (uintptr_t)vec) && (src_offset < sz * elem_sz);
+
+    if(meta__->capacity - sz < count)
+    {
+        vec = internal_cvec_grow_(vec, internal_cvec_add_sat_(sz, count));
+        if(!vec)
+            return (NULL);
+
+        meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    uint8_t* data  = (uint8_t*)vec;
+    uint8_t* slot  = data + index * elem_sz;
+    uint64_t bytes = count * elem_sz;
+
+    memmove(slot + bytes, slot, (sz - index) * elem_sz);
+    INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, (sz - index) * elem_sz);
+
+    if(!aliased)
+        memcpy(slot, src, bytes);
+    else
+    {
+        // The part of src past index moved up with the tail
+        uint64_t split = index * elem_sz;
+        uint64_t head  = (src_offset < split) ? split - src_offset : 0;
+        if(head > bytes)
+            head = bytes;
+
+        memcpy(slot, data + src_offset, head);
+        memcpy(slot + head, data + src_offset + head + bytes, bytes - head);
+    }
+
+    meta__->size += count;
+
+    return vec;
+}
+
+
+// Insert one element before index, see cvec_insert_n
+static inline
+void* cvec_insert(void* vec, size_t index, const void* elem)
+{
+    return cvec_insert_n(vec, index, elem, 1);
+}
+
+
+// Move count elements starting at first out of src and insert them before
+// index in dst. The elements are copied once, straight into dst, and change
+// owner: no destructor runs. The range is clamped to the end of src and both
+// vectors must differ and hold the same type size.
+// Returns the (possibly moved) dst, or NULL on failure with both vectors untouched.
+static inline
+void* cvec_splice(void* dst, size_t index, void* src, size_t first, size_t count)
+{
+    if(!dst)
+        return (NULL);
+
+    if(!src || src == dst || cvec_get_type_sz(dst) != cvec_get_type_sz(src))
+        return dst;
+
+    internal_cvec_metadata_* src_meta__ = INTERNAL_CVEC_GET_METADATA(src);
+
+    // dst is checked by cvec_insert_n
+    if(src_meta__->flags & CVEC_FLAG_DEQUE)
+        return (NULL);
+
+    uint64_t               sz         = src_meta__->size;
+    uint64_t               elem_sz    = src_meta__->typesize;
+
+    if(first >= sz || index > cvec_get_sz(dst))
+        return dst;
+
+    if(count > sz - first)
+        count = sz - first;
+
+    dst = cvec_insert_n(dst, index, (uint8_t*)src + first * elem_sz, count);
+    if(!dst)
+        return (NULL);
+
+    // Close the gap left in src
+    uint8_t* data = (uint8_t*)src;
+    memmove(data + first * elem_sz,
+            data + (first + count) * elem_sz,
+            (sz - (first + count)) * elem_sz);
+    INTERNAL_CVEC_STAT_ADD(src_meta__, memmove_bytes, (sz - (first + count)) * elem_sz);
+
+    src_meta__->size -= count;
+
+    return dst;
+}
+
+
+// Erase count elements starting at first from the vector.
+// Destructors run on the whole range, then the tail is shifted with a single memmove.
+static inline
+void cvec_erase_range(void* vec, size_t first, size_t count)
+{
+    if(!vec) return ;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return ;
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    uint8_t* data = (uint8_t*)vec;
+
+    // If out of bounds, do not erase anything
+    if(first >= sz) return ;
+
+    // Clamp the range to the end of the vector
+    if(count > sz - first)
+        count = sz - first;
+
+    internal_cvec_destroy_range_(meta__, data, first, count);
+
+    // Shift elements
+    memmove(data + first * elem_sz,
+            data + (first + count) * elem_sz,
+            (sz - (first + count)) * elem_sz);
+    INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, (sz - (first + count)) * elem_sz);
+
+    meta__->size -= count;
+
+    return ;
+}
+
+
+// Erase an element from the vector
+static inline
+void cvec_erase(void* vec, size_t index)
+{    
+    cvec_erase_range(vec, index, 1);
+}
+
+
+// Erase an element by moving the last element into its place (does not keep order)
+static inline
+void cvec_erase_unordered(void* vec, size_t index)
+{
+    if(!vec) return ;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return ;
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    uint8_t* data = (uint8_t*)vec;
+
+    // If out of bounds, do not erase anything
+    if(index >= sz) return ;
+
+    internal_cvec_destroy_range_(meta__, data, index, 1);
+
+    if(index != sz - 1)
+        memcpy(data + index * elem_sz, data + (sz - 1) * elem_sz, elem_sz);
+
+    meta__->size--;
+
+    return ;
+}
+
+
+// typedef of erase predicate, returns non-zero for elements to erase
+typedef int32_t (*cvec_elem_predicate)(const void* elem, void* ctx);
+
+// Erase every element for which pred returns non-zero, keeping the order of the rest.
+// Compacts in a single pass and returns the number of erased elements.
+static inline
+uint64_t cvec_erase_if(void* vec, cvec_elem_predicate pred, void* ctx)
+{
+    if(!vec || !pred) return 0;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return 0;
+
+    uint64_t               sz         = meta__->size;
+    uint64_t               elem_sz    = meta__->typesize;
+
+    uint8_t* data = (uint8_t*)vec;
+    uint64_t kept = 0;
+    uint64_t run  = 0;      // start of the current run of removed elements
+
+    for(uint64_t i = 0; i < sz; i++)
+    {
+        uint8_t* elem = data + i * elem_sz;
+
+        if(pred(elem, ctx))
+            continue;
+
+        // Kept elements only land below the run, destroy it in one go
+        if(run != i)
+            internal_cvec_destroy_range_(meta__, data, run, i - run);
+        run = i + 1;
+
+        if(kept != i)
+            memcpy(data + kept * elem_sz, elem, elem_sz);
+        kept++;
+    }
+
+    internal_cvec_destroy_range_(meta__, data, run, sz - run);
+
+    meta__->size = kept;
+
+    return sz - kept;
+}
+
+// Destroy every element, keeping the capacity
+static inline
+void cvec_clear(void* vec)
+{
+    if(!vec) return ;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    internal_cvec_destroy_all_(meta__, (uint8_t*)vec);
+    meta__->size = 0;
+    meta__->head = 0;
+}
+
+
+// Trim the capacity down to max(size, keep_capacity) so the allocator can
+// give the memory back. Returns the (possibly moved) vector; if the
+// reallocation fails the vector is returned unchanged.
+static inline
+void* cvec_release(void* vec, size_t keep_capacity)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return vec;
+
+    uint64_t target = (meta__->size > keep_capacity) ? meta__->size : keep_capacity;
+
+    if(meta__->capacity <= target)
+        return vec;
+
+    void* shrunk = internal_cvec_set_capacity_(vec, target);
+
+    return shrunk ? shrunk : vec;
+}
+
+
+// Trim the capacity down to the size
+static inline
+void* cvec_shrink_to_fit(void* vec)
+{
+    return cvec_release(vec, 0);
+}
+
+
+// Free the vector and its metadata
+static inline
+void cvec_free(void* vec)
+{
+    if(!vec) return ;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    internal_cvec_destroy_all_(meta__, (uint8_t*)vec);
+
+    // Inline buffers belong to the caller
+    if(meta__->flags & CVEC_FLAG_INLINE)
+        return ;
+
+#if defined(CVEC_HAS_MMAP)
+    if(meta__->flags & CVEC_FLAG_FILE)
+    {
+        cvec_file_header* header = (cvec_file_header*)internal_cvec_block_base_(meta__);
+
+        int fd = (int)header->fd;
+
+        munmap(header, header->map_len);
+        if(fd >= 0)
+            close(fd);
+        return ;
+    }
+#endif
+
+#if defined(INTERNAL_CVEC_MMAP_GROWTH)
+    if(meta__->flags & CVEC_FLAG_MMAP)
+    {
+        munmap(internal_cvec_block_base_(meta__),
+               internal_cvec_map_len_(internal_cvec_block_sz_(meta__, meta__->capacity)));
+        return ;
+    }
+#endif
+
+    internal_cvec_mem_free_(meta__->allocator, internal_cvec_block_base_(meta__),
+                            internal_cvec_block_sz_(meta__, meta__->capacity));
+    return ;
+}
+
+
+// Iteration.
+// CVEC_FOREACH walks a vector with a typed pointer, the size is read once
+// instead of reading the header on every check. The _PREFETCH variants also
+// prefetch dist elements ahead; CVEC_PREFETCH_DISTANCE(T) picks a distance of
+// about CVEC_PREFETCH_BYTES for a type. For vectors of pointers,
+// CVEC_FOREACH_PREFETCH_DEREF prefetches the pointed-to object instead, which
+// is what helps pointer chasing. vec is evaluated more than once.
+
+#ifndef CVEC_PREFETCH_BYTES
+#define CVEC_PREFETCH_BYTES 512
+#endif
+
+// Kept defined after this header, the CVEC_FOREACH_* macros expand to it
+#if defined(__GNUC__) || defined(__clang__)
+#define CVEC_PREFETCH(addr) __builtin_prefetch((const void*)(addr))
+#else
+#define CVEC_PREFETCH(addr) ((void)(addr))
+#endif
+
+#define CVEC_PREFETCH_DISTANCE(T)                                                \
+    ((CVEC_PREFETCH_BYTES / sizeof(T)) ? (CVEC_PREFETCH_BYTES / sizeof(T)) : 1)
+
+// Prefetches dist elements past it when that is still inside the vector.
+// Kept as functions so the macros never form a pointer past the end.
+static inline
+void internal_cvec_prefetch_ahead_(const void* it, uint64_t left, uint64_t dist, uint64_t elem_sz)
+{
+    if(left > dist)
+        CVEC_PREFETCH((const uint8_t*)it + dist * elem_sz);
+}
+
+static inline
+void internal_cvec_prefetch_deref_(const void* it, uint64_t left, uint64_t dist)
+{
+    if(left > dist)
+        CVEC_PREFETCH(((void* const*)it)[dist]);
+}
+
+// The outer loop only scopes the hoisted count, break leaves both
+#define CVEC_FOREACH(T, it, vec)                                                 \
+    for(uint64_t it##_left__ = cvec_get_sz(vec), it##_once__ = 1;                \
+        it##_once__; it##_once__ = 0)                                            \
+        for(T* it = (T*)(vec); it##_left__ > 0; it##_left__--, it++)
+
+#define CVEC_FOREACH_PREFETCH(T, it, vec, dist)                                  \
+    for(uint64_t it##_left__ = cvec_get_sz(vec), it##_once__ = 1;                \
+        it##_once__; it##_once__ = 0)                                            \
+        for(T* it = (T*)(vec);                                                   \
+            it##_left__ > 0 &&                                                   \
+            (internal_cvec_prefetch_ahead_(it, it##_left__, (dist), sizeof(T)),  \
+             1);                                                                 \
+            it##_left__--, it++)
+
+#define CVEC_FOREACH_PREFETCH_DEREF(T, it, vec, dist)                            \
+    for(uint64_t it##_left__ = cvec_get_sz(vec), it##_once__ = 1;                \
+        it##_once__; it##_once__ = 0)                                            \
+        for(T* it = (T*)(vec);                                                   \
+            it##_left__ > 0 &&                                                   \
+            (internal_cvec_prefetch_deref_(it, it##_left__, (dist)), 1);         \
+            it##_left__--, it++)
+
+// Called on every element by cvec_for_each
+typedef void (*cvec_elem_visitor)(void* elem, void* ctx);
+
+// Calls fn on every element in order, prefetching distance elements ahead
+// (0 picks about CVEC_PREFETCH_BYTES ahead for the type size)
+static inline
+void cvec_for_each_prefetch(void* vec, cvec_elem_visitor fn, void* ctx, size_t distance)
+{
+    if(!vec || !fn) return ;
+
+    const internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t sz      = meta__->size;
+    uint64_t elem_sz = meta__->typesize;
+    uint8_t* data    = (uint8_t*)vec;
+
+    if(distance == 0)
+        distance = (CVEC_PREFETCH_BYTES / elem_sz) ? (size_t)(CVEC_PREFETCH_BYTES / elem_sz) : 1;
+
+    uint64_t i     = 0;
+    uint64_t ahead = (sz > distance) ? sz - distance : 0;
+
+    for(; i < ahead; i++)
+    {
+        CVEC_PREFETCH(data + (i + distance) * elem_sz);
+        fn(data + i * elem_sz, ctx);
+    }
+
+    for(; i < sz; i++)
+        fn(data + i * elem_sz, ctx);
+}
+
+// Calls fn on every element in order
+static inline
+void cvec_for_each(void* vec, cvec_elem_visitor fn, void* ctx)
+{
+    if(!vec || !fn) return ;
+
+    const internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t sz      = meta__->size;
+    uint64_t elem_sz = meta__->typesize;
+    uint8_t* data    = (uint8_t*)vec;
+
+    for(uint64_t i = 0; i < sz; i++)
+        fn(data + i * elem_sz, ctx);
+}
+
+
+// Instrumentation.
+// Build with CVEC_STATS defined to count reallocations, bytes moved on growth,
+// bytes zeroed and bytes shifted by erase/insert per vector. Without it the
+// functions below still exist but report nothing and the hooks cost nothing.
+
+// Labels the vector in cvec_stats_dump, usually with a call site name.
+// The string must outlive the vector.
+static inline
+void cvec_stats_set_tag(void* vec, const char* tag)
+{
+#if defined(CVEC_STATS)
+    if(vec)
+        INTERNAL_CVEC_GET_METADATA(vec)->stats.tag = tag;
+#else
+    (void)vec; (void)tag;
+#endif
+}
+
+// Copies the counters of vec to out, returns 0 (out zeroed) without CVEC_STATS
+static inline
+int32_t cvec_stats_get(const void* vec, cvec_stats* out)
+{
+    if(!out) return 0;
+
+    memset(out, 0, sizeof(*out));
+
+#if defined(CVEC_STATS)
+    if(!vec) return 0;
+
+    *out = INTERNAL_CVEC_GET_METADATA(vec)->stats;
+    return 1;
+#else
+    (void)vec;
+    return 0;
+#endif
+}
+
+// Zeroes the counters of vec, the tag is kept
+static inline
+void cvec_stats_reset(void* vec)
+{
+#if defined(CVEC_STATS)
+    if(!vec) return ;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    const char* tag = meta__->stats.tag;
+    memset(&meta__->stats, 0, sizeof(meta__->stats));
+    meta__->stats.tag           = tag;
+    meta__->stats.peak_capacity = meta__->capacity;
+#else
+    (void)vec;
+#endif
+}
+
+// Prints the counters of vec as one line to out
+static inline
+void cvec_stats_dump(FILE* out, const void* vec)
+{
+    cvec_stats stats;
+
+    if(!out || !cvec_stats_get(vec, &stats))
+        return ;
+
+    fprintf(out, "cvec %s: size=%llu capacity=%llu peak_capacity=%llu reallocs=%llu "
+                 "growth_copy_bytes=%llu memset_bytes=%llu memmove_bytes=%llu\n",
+            stats.tag ? stats.tag : "(untagged)",
+            (unsigned long long)cvec_get_sz(vec),
+            (unsigned long long)cvec_get_capacity(vec),
+            (unsigned long long)stats.peak_capacity,
+            (unsigned long long)stats.reallocs,
+            (unsigned long long)stats.growth_copy_bytes,
+            (unsigned long long)stats.memset_bytes,
+            (unsigned long long)stats.memmove_bytes);
+}
+
+
+// Deque mode.
+// A deque is a vector whose elements form a ring starting at the head slot,
+// so pushing and popping at both ends is O(1) with no memmove. It grows
+// through the same buffer as a plain vector, unwrapping the ring by moving
+// the shorter side. Apart from the cvec_deque_* functions only cvec_get_sz,
+// cvec_get_capacity, cvec_clear and cvec_free understand the ring; the
+// generic mutators (grow, resize, push, insert, splice, erase, release and
+// fd io) reject a deque and leave it untouched: they fail like on an
+// allocation error, release returns it as is. cvec_deque_linearize turns it
+// back into a plain vector.
+
+// Returns a deque with reserved space
+static inline
+void* cvec_deque_reserve(size_t capacity,
+                         size_t elem_sz,
+                         cvec_elem_destructor destructor)
+{
+    void* vec = cvec_reserve(capacity ? capacity : 1, elem_sz, destructor);
+    if(!vec)
+        return (NULL);
+
+    INTERNAL_CVEC_GET_METADATA(vec)->flags |= CVEC_FLAG_DEQUE;
+
+    return vec;
+}
+
+// Returns a deque with capacity of 1
+static inline
+void* cvec_deque_create(size_t elem_sz,
+                        cvec_elem_destructor destructor)
+{
+    return cvec_deque_reserve(1, elem_sz, destructor);
+}
+
+// Returns the element at index counted from the front, NULL if out of bounds
+static inline
+void* cvec_deque_at(const void* vec, size_t index)
+{
+    if(!vec) return (NULL);
+
+    const internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(index >= meta__->size)
+        return (NULL);
+
+    uint64_t slot = meta__->head + index;
+    if(slot >= meta__->capacity)
+        slot -= meta__->capacity;
+
+    return (uint8_t*)vec + slot * meta__->typesize;
+}
+
+// Grows a full deque and unwraps the ring into the new space
+static inline
+void* internal_cvec_deque_grow_(void* vec)
+{
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t old_capacity = meta__->capacity;
+    uint64_t elem_sz      = meta__->typesize;
+
+    vec = internal_cvec_grow_(vec, old_capacity + 1);
+    if(!vec)
+        return (NULL);
+
+    meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t head    = meta__->head;
+    uint64_t front   = old_capacity - head;    // elements in [head, old_capacity)
+    uint64_t wrapped = meta__->size - front;   // elements in [0, wrapped)
+    uint64_t added   = meta__->capacity - old_capacity;
+    uint8_t* data    = (uint8_t*)vec;
+
+    if(head == 0)
+        return vec;
+
+    if(wrapped <= front && wrapped <= added)
+    {
+        // Append the wrapped part after the old end
+        memcpy(data + old_capacity * elem_sz, data, wrapped * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, wrapped * elem_sz);
+    }
+    else
+    {
+        // Slide the front part to the new end
+        meta__->head = meta__->capacity - front;
+        memmove(data + meta__->head * elem_sz, data + head * elem_sz, front * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, front * elem_sz);
+    }
+
+    return vec;
+}
+
+// Push back an element in the deque
+static inline
+void* cvec_deque_push_back(void* vec, const void* elem)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->size == meta__->capacity)
+    {
+        vec = internal_cvec_deque_grow_(vec);
+        if(!vec)
+            return (NULL);
+
+        meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    uint64_t slot = meta__->head + meta__->size;
+    if(slot >= meta__->capacity)
+        slot -= meta__->capacity;
+
+    memcpy((uint8_t*)vec + slot * meta__->typesize, elem, meta__->typesize);
+    meta__->size++;
+
+    return vec;
+}
+
+// Push front an element in the deque
+static inline
+void* cvec_deque_push_front(void* vec, const void* elem)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->size == meta__->capacity)
+    {
+        vec = internal_cvec_deque_grow_(vec);
+        if(!vec)
+            return (NULL);
+
+        meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    meta__->head = (meta__->head ? meta__->head : meta__->capacity) - 1;
+
+    memcpy((uint8_t*)vec + meta__->head * meta__->typesize, elem, meta__->typesize);
+    meta__->size++;
+
+    return vec;
+}
+
+// Pop the front element. It is copied to out when out is not NULL (the
+// destructor does not run, ownership moves), destroyed otherwise.
+// Returns 0 if the deque is empty.
+static inline
+int32_t cvec_deque_pop_front(void* vec, void* out)
+{
+    if(!vec) return 0;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->size == 0)
+        return 0;
+
+    if(out)
+        memcpy(out, (uint8_t*)vec + meta__->head * meta__->typesize, meta__->typesize);
+    else
+        internal_cvec_destroy_range_(meta__, (uint8_t*)vec, meta__->head, 1);
+
+    meta__->head = (meta__->head + 1 == meta__->capacity) ? 0 : meta__->head + 1;
+    meta__->size--;
+
+    // An empty ring restarts at slot 0
+    if(meta__->size == 0)
+        meta__->head = 0;
+
+    return 1;
+}
+
+// Pop the back element, see cvec_deque_pop_front
+static inline
+int32_t cvec_deque_pop_back(void* vec, void* out)
+{
+    if(!vec) return 0;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->size == 0)
+        return 0;
+
+    uint64_t slot = meta__->head + meta__->size - 1;
+    if(slot >= meta__->capacity)
+        slot -= meta__->capacity;
+
+    if(out)
+        memcpy(out, (uint8_t*)vec + slot * meta__->typesize, meta__->typesize);
+    else
+        internal_cvec_destroy_range_(meta__, (uint8_t*)vec, slot, 1);
+
+    meta__->size--;
+
+    if(meta__->size == 0)
+        meta__->head = 0;
+
+    return 1;
+}
+
+// Swaps n bytes between two non overlapping ranges through a small stack buffer
+static inline
+void internal_cvec_swap_bytes_(uint8_t* a, uint8_t* b, uint64_t n)
+{
+    uint8_t tmp[256];
+
+    while(n)
+    {
+        uint64_t step = (n < sizeof(tmp)) ? n : sizeof(tmp);
+
+        memcpy(tmp, a, step);
+        memcpy(a, b, step);
+        memcpy(b, tmp, step);
+
+        a += step;
+        b += step;
+        n -= step;
+    }
+}
+
+// Rotates [p, p + left + right) left by left bytes with block swaps,
+// each swap puts the shorter block in its final place
+static inline
+void internal_cvec_rotate_bytes_(uint8_t* p, uint64_t left, uint64_t right)
+{
+    while(left && right)
+    {
+        if(left <= right)
+        {
+            internal_cvec_swap_bytes_(p, p + left, left);
+            p     += left;
+            right -= left;
+        }
+        else
+        {
+            internal_cvec_swap_bytes_(p + left - right, p + left, right);
+            left -= right;
+        }
+    }
+}
+
+// Rotates the ring so the front element is at index 0 and turns the deque
+// back into a plain vector, in place. Returns the vector.
+static inline
+void* cvec_deque_linearize(void* vec)
+{
+    if(!vec) return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t head    = meta__->head;
+    uint64_t elem_sz = meta__->typesize;
+    uint8_t* data    = (uint8_t*)vec;
+
+    if(head + meta__->size <= meta__->capacity)
+    {
+        memmove(data, data + head * elem_sz, meta__->size * elem_sz);
+        INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, meta__->size * elem_sz);
+    }
+    else
+    {
+        uint64_t front   = meta__->capacity - head;   // elements in [head, capacity)
+        uint64_t wrapped = meta__->size - front;      // elements in [0, wrapped)
+        uint64_t gap     = meta__->capacity - meta__->size;
+
+        if(front <= gap)
+        {
+            // The front part fits in the gap: slide the wrapped part up past it
+            memmove(data + front * elem_sz, data, wrapped * elem_sz);
+            memcpy(data, data + head * elem_sz, front * elem_sz);
+        }
+        else
+        {
+            // Close the gap, then swap the two parts into order
+            memmove(data + wrapped * elem_sz, data + head * elem_sz, front * elem_sz);
+            internal_cvec_rotate_bytes_(data, wrapped * elem_sz, front * elem_sz);
+        }
+
+        INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, meta__->size * elem_sz);
+    }
+
+    meta__->head   = 0;
+    meta__->flags &= ~CVEC_FLAG_DEQUE;
+
+    return vec;
+}
+
+
+// File backed vectors.
+// cvec_map_file maps a cvec file so restarting is a page-in instead of a
+// rebuild. Read-only maps are private and their data pages are protected,
+// writable maps are shared and grow the file with ftruncate + remap.
+// cvec_free unmaps the file; destructors are not stored, so none run.
+// Compiled in with CVEC_ENABLE_MAP_FILE.
+#if defined(CVEC_HAS_MMAP) && defined(CVEC_ENABLE_MAP_FILE)
+
+#define CVEC_MAP_READONLY 0u
+#define CVEC_MAP_WRITE    (1u << 0)   // shared writable mapping, growth extends the file
+#define CVEC_MAP_CREATE   (1u << 1)   // create the file if missing or empty (implies CVEC_MAP_WRITE)
+
+// Maps the cvec file at path. elem_sz must match the stored type size (0 to
+// accept it). Returns NULL if the file cannot be mapped or its stamp, version
+// or endianness do not match.
+static inline
+void* cvec_map_file(const char* path, size_t elem_sz, uint32_t flags)
+{
+    if(!path) return (NULL);
+
+    int32_t writable = (flags & (CVEC_MAP_WRITE | CVEC_MAP_CREATE)) != 0;
+
+    int fd = open(path, writable ? (O_RDWR | ((flags & CVEC_MAP_CREATE) ? O_CREAT : 0)) : O_RDONLY, 0644);
+    if(fd < 0)
+        return (NULL);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return (NULL);
+    }
+
+    uint64_t file_len    = (uint64_t)st.st_size;
+    uint64_t data_offset = 0;
+    int32_t  fresh       = 0;
+
+    // New file: a stamp page, the metadata image at its end, no data yet
+    if(file_len == 0 && (flags & CVEC_MAP_CREATE) && elem_sz)
+    {
+        data_offset = internal_cvec_map_len_(sizeof(cvec_file_header) + sizeof(internal_cvec_metadata_));
+
+        if(ftruncate(fd, (off_t)data_offset) != 0)
+        {
+            close(fd);
+            return (NULL);
+        }
+
+        file_len = data_offset;
+        fresh    = 1;
+    }
+
+    if(file_len < sizeof(cvec_file_header) + sizeof(internal_cvec_metadata_))
+    {
+        close(fd);
+        return (NULL);
+    }
+
+    uint64_t map_len = internal_cvec_map_len_(file_len);
+
+    uint8_t* base = (uint8_t*)mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                                   writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if((void*)base == MAP_FAILED)
+    {
+        close(fd);
+        return (NULL);
+    }
+
+    cvec_file_header* header = (cvec_file_header*)base;
+
+    if(fresh)
+    {
+        memcpy(header->magic, CVEC_FILE_MAGIC, sizeof(header->magic));
+        header->version     = CVEC_FILE_VERSION;
+        header->endian      = CVEC_FILE_ENDIAN;
+        header->data_offset = data_offset;
+        header->meta_size   = (uint32_t)sizeof(internal_cvec_metadata_);
+
+        ((internal_cvec_metadata_*)(base + data_offset) - 1)->typesize = elem_sz;
+    }
+
+    data_offset = header->data_offset;
+
+    // The data must stay max aligned like a heap vector's
+    int32_t valid = memcmp(header->magic, CVEC_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+                    header->version == CVEC_FILE_VERSION &&
+                    header->endian  == CVEC_FILE_ENDIAN  &&
+                    header->meta_size == sizeof(internal_cvec_metadata_) &&
+                    data_offset >= sizeof(cvec_file_header) + sizeof(internal_cvec_metadata_) &&
+                    data_offset <= file_len && data_offset % 16 == 0;
+
+    // Only looked at once data_offset is known to lie inside the file
+    internal_cvec_metadata_* meta__ = valid ? (internal_cvec_metadata_*)(base + data_offset) - 1 : NULL;
+
+    valid = valid && meta__->typesize && (!elem_sz || meta__->typesize == elem_sz) &&
+            meta__->size <= meta__->capacity &&
+            meta__->capacity <= (file_len - data_offset) / meta__->typesize;
+
+    if(!valid)
+    {
+        munmap(base, map_len);
+        close(fd);
+        return (NULL);
+    }
+
+    // Only size, capacity and typesize are meaningful on disk
+    meta__->destructor       = NULL;
+    meta__->range_destructor = NULL;
+    meta__->head             = 0;
+    meta__->growth_param     = 0;
+    meta__->growth_fn        = NULL;
+    meta__->growth_kind      = 0;
+    meta__->flags            = CVEC_FLAG_FILE | (writable ? 0 : CVEC_FLAG_READONLY);
+    meta__->allocator        = NULL;
+    meta__->alignment        = 0;
+    meta__->offset           = (uint32_t)(data_offset - sizeof(internal_cvec_metadata_));
+#if defined(CVEC_STATS)
+    memset(&meta__->stats, 0, sizeof(meta__->stats));
+#endif
+
+    header->map_len = map_len;
+
+    if(writable)
+        header->fd = fd;
+    else
+    {
+        // The mapping outlives the descriptor, growth is refused
+        header->fd       = -1;
+        meta__->capacity = meta__->size;
+        close(fd);
+
+        if(data_offset % internal_cvec_map_len_(1) == 0 && map_len > data_offset)
+            mprotect(base + data_offset, map_len - data_offset, PROT_READ);
+    }
+
+    return meta__ + 1;
+}
+
+// Flushes a writable mapped file to disk, returns 0 on failure
+static inline
+int32_t cvec_sync_file(void* vec)
+{
+    if(!vec) return 0;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(!(meta__->flags & CVEC_FLAG_FILE))
+        return 0;
+
+    cvec_file_header* header = (cvec_file_header*)internal_cvec_block_base_(meta__);
+
+    return msync(header, header->map_len, MS_SYNC) == 0;
+}
+
+#endif // CVEC_HAS_MMAP && CVEC_ENABLE_MAP_FILE
+
+
+// Stream I/O.
+// cvec_write_fd writes a cvec_stream_header and the payload with writev,
+// cvec_read_fd reads the header and then the payload straight into a vector
+// reserved to the exact size. cvec_append_fd reads raw elements into the
+// spare capacity of an existing vector, chunk by chunk, without a bounce buffer.
+// Partial reads and writes are resumed, EINTR is retried.
+#if defined(CVEC_HAS_FD_IO)
+
+// Bytes reserved ahead of a read whose count comes from the caller or a stream
+#define INTERNAL_CVEC_FD_CHUNK ((uint64_t)1 << 20)
+
+// Writes the header and the elements of vec to fd, returns 0 on failure
+static inline
+int32_t cvec_write_fd(int fd, const void* vec)
+{
+    if(!vec) return 0;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return 0;
+
+    cvec_stream_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CVEC_STREAM_MAGIC, sizeof(header.magic));
+    header.version  = CVEC_FILE_VERSION;
+    header.endian   = CVEC_FILE_ENDIAN;
+    header.typesize = meta__->typesize;
+    header.size     = meta__->size;
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len  = sizeof(header);
+    iov[1].iov_base = (void*)vec;
+    iov[1].iov_len  = (size_t)(meta__->size * meta__->typesize);
+
+    struct iovec* cur  = iov;
+    int           left = 2;
+
+    while(left > 0)
+    {
+        ssize_t n = writev(fd, cur, left);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return 0;
+        }
+
+        // Skip what was written, a single call may stop anywhere
+        size_t done = (size_t)n;
+        while(left > 0 && done >= cur->iov_len)
+        {
+            done -= cur->iov_len;
+            cur++;
+            left--;
+        }
+
+        if(left > 0)
+        {
+            cur->iov_base = (uint8_t*)cur->iov_base + done;
+            cur->iov_len -= done;
+        }
+    }
+
+    return 1;
+}
+
+// Reads up to len bytes into dst, stopping early only at end of file.
+// Returns the number of bytes read or -1 on error.
+static inline
+int64_t internal_cvec_read_full_(int fd, void* dst, uint64_t len)
+{
+    uint64_t done = 0;
+
+    while(done < len)
+    {
+        uint64_t want = len - done;
+
+        // Keep single reads within what every kernel accepts
+        if(want > (1u << 30))
+            want = (1u << 30);
+
+        ssize_t n = read(fd, (uint8_t*)dst + done, (size_t)want);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if(n == 0)
+            break;
+
+        done += (uint64_t)n;
+    }
+
+    return (int64_t)done;
+}
+
+// Appends up to count raw elements read from fd (UINT64_MAX reads to end of
+// file), growing the vector with its growth policy as the spare capacity
+// fills. vec_ptr is the address of the vector variable like in
+// cvec_emplace_back_n. A trailing partial element is dropped.
+// Returns the number of elements appended; on a read or allocation error
+// the elements read so far are kept and errno tells what happened.
+static inline
+uint64_t cvec_append_fd(void* vec_ptr, int fd, uint64_t count)
+{
+    void** pvec__ = (void**)vec_ptr;
+
+    if(!pvec__ || !*pvec__)
+        return 0;
+
+    void* vec = *pvec__;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    if(meta__->flags & CVEC_FLAG_DEQUE)
+        return 0;
+
+    uint64_t elem_sz  = meta__->typesize;
+    uint64_t appended = 0;
+    uint64_t partial  = 0;      // bytes of an incomplete last element
+
+    // The block of the whole vector, metadata included, must fit a size_t
+    uint64_t max_capacity = internal_cvec_max_capacity_(elem_sz, meta__->alignment);
+    if(count != UINT64_MAX && (meta__->size > max_capacity || count > max_capacity - meta__->size))
+        return 0;
+
+    // A known count is reserved up to INTERNAL_CVEC_FD_CHUNK bytes, beyond that
+    // the vector grows as data arrives so a bogus count cannot size the block
+    uint64_t first = (count < INTERNAL_CVEC_FD_CHUNK / elem_sz) ? count : INTERNAL_CVEC_FD_CHUNK / elem_sz;
+
+    if(count != UINT64_MAX && meta__->capacity - meta__->size < first)
+    {
+        vec = internal_cvec_grow_(vec, internal_cvec_add_sat_(meta__->size, first));
+        if(!vec)
+            return 0;
+
+        *pvec__ = vec;
+        meta__  = INTERNAL_CVEC_GET_METADATA(vec);
+    }
+
+    while(appended < count)
+    {
+        if(meta__->capacity == meta__->size)
+        {
+            vec = internal_cvec_grow_(vec, meta__->size + 1);
+            if(!vec)
+                break;
+
+            *pvec__ = vec;
+            meta__  = INTERNAL_CVEC_GET_METADATA(vec);
+        }
+
+        uint64_t room  = meta__->capacity - meta__->size;
+        uint64_t chunk = (count - appended < room) ? count - appended : room;
+
+        uint8_t* tail  = (uint8_t*)vec + meta__->size * elem_sz;
+        uint64_t bytes = chunk * elem_sz;
+
+        // A wrapped byte count would read nothing forever
+        if(bytes == 0 || bytes / elem_sz != chunk)
+            break;
+
+        // Only the end of the file cuts a read short
+        int64_t n = internal_cvec_read_full_(fd, tail, bytes);
+        if(n < 0)
+            break;
+
+        uint64_t whole = (uint64_t)n / elem_sz;
+
+        meta__->size += whole;
+        appended     += whole;
+        partial       = (uint64_t)n - whole * elem_sz;
+
+        if((uint64_t)n < bytes)
+            break;
+    }
+
+    // A dropped partial element must not show up as stale data
+    if(partial && !(meta__->flags & CVEC_FLAG_NO_ZERO_INIT))
+        memset((uint8_t*)vec + meta__->size * elem_sz, 0, partial);
+
+    return appended;
+}
+
+// Reads a stream written by cvec_write_fd. elem_sz must match the stored type
+// size (0 to accept it). Returns NULL on a read error, a short stream or a
+// header that does not match.
+static inline
+void* cvec_read_fd(int fd, size_t elem_sz, cvec_elem_destructor destructor)
+{
+    cvec_stream_header header;
+
+    if(internal_cvec_read_full_(fd, &header, sizeof(header)) != (int64_t)sizeof(header))
+        return (NULL);
+
+    if(memcmp(header.magic, CVEC_STREAM_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CVEC_FILE_VERSION || header.endian != CVEC_FILE_ENDIAN ||
+       !header.typesize || (elem_sz && header.typesize != elem_sz))
+        return (NULL);
+
+    // The whole block, metadata included, must fit a size_t
+    if(header.typesize > SIZE_MAX || header.size > internal_cvec_max_capacity_(header.typesize, 0))
+        return (NULL);
+
+    // The header is untrusted: reserve one chunk, cvec_append_fd grows with the data
+    uint64_t first = INTERNAL_CVEC_FD_CHUNK / header.typesize;
+    if(first == 0)
+        first = 1;
+    if(first > header.size)
+        first = header.size;
+
+    void* vec = cvec_reserve((size_t)first, (size_t)header.typesize, destructor);
+    if(!vec)
+        return (NULL);
+
+    if(cvec_append_fd(&vec, fd, header.size) != header.size)
+    {
+        // Elements of a short stream are not valid objects, skip the destructor
+        INTERNAL_CVEC_GET_METADATA(vec)->destructor = NULL;
+        cvec_free(vec);
+        return (NULL);
+    }
+
+    // Growth overshoots past the first chunk, drop the slack (best effort)
+    return cvec_shrink_to_fit(vec);
+}
+
+#endif // CVEC_HAS_FD_IO
+
+
+// Delta + varint encoding of integer vectors.
+// cvec_delta_encode_<type> stores each element as the zigzag varint of its
+// difference to the previous one, so sorted or clustered values take one or
+// two bytes instead of four or eight. The encoding is a byte cvec: a width
+// tag (32 or 64), the element count as a varint, then the deltas. It returns
+// NULL when the vector does not hold elements of that type size.
+// cvec_delta_decode_<type> checks it and writes straight into a vector
+// reserved to the exact count. The _fd variants send the encoding through
+// cvec_write_fd / cvec_read_fd.
+
+// Appends the LEB128 varint of x at p, returns the new end
+static inline
+uint8_t* internal_cvec_varint_put_(uint8_t* p, uint64_t x)
+{
+    while(x >= 0x80)
+    {
+        *p++ = (uint8_t)(x | 0x80);
+        x  >>= 7;
+    }
+    *p++ = (uint8_t)x;
+
+    return p;
+}
+
+// Reads a varint of at most bits bits from [*p, end), returns 0 if truncated or too long
+static inline
+int32_t internal_cvec_varint_get_(const uint8_t** p, const uint8_t* end, uint32_t bits, uint64_t* out)
+{
+    const uint8_t* cur   = *p;
+    uint64_t       x     = 0;
+    uint32_t       shift = 0;
+
+    for(;;)
+    {
+        if(cur == end || shift >= bits)
+            return 0;
+
+        uint8_t byte = *cur++;
+
+        // The last byte must not carry bits past the width
+        if(bits - shift < 7 && (byte & 0x7f) >> (bits - shift))
+            return 0;
+
+        x |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+
+        if(!(byte & 0x80))
+            break;
+    }
+
+    *p   = cur;
+    *out = x;
+    return 1;
+}
+
+// Encodes n elements of 32 or 64 bits, returns a byte cvec or NULL on failure
+static inline
+uint8_t* internal_cvec_delta_encode_(const void* data, uint64_t n, uint32_t bits)
+{
+    uint64_t mask = (bits == 64) ? UINT64_MAX : (((uint64_t)1 << bits) - 1);
+
+    // Room for the header, most deltas then fit in a byte or two
+    uint8_t* out = (uint8_t*)cvec_reserve((size_t)(n * 2 + 16), 1, NULL);
+    if(!out)
+        return (NULL);
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(out);
+
+    uint8_t* p = internal_cvec_varint_put_(out, bits);
+    p = internal_cvec_varint_put_(p, n);
+
+    uint64_t prev = 0;
+
+    for(uint64_t i = 0; i < n; i++)
+    {
+        // A varint of a 64 bit value is at most 10 bytes
+        if(meta__->capacity - (uint64_t)(p - out) < 10)
+        {
+            uint64_t used = (uint64_t)(p - out);
+
+            meta__->size = used;
+            uint8_t* grown = (uint8_t*)internal_cvec_grow_(out, used + 10);
+            if(!grown)
+            {
+                cvec_free(out);
+                return (NULL);
+            }
+
+            out    = grown;
+            meta__ = INTERNAL_CVEC_GET_METADATA(out);
+            p      = out + used;
+        }
+
+        uint64_t x;
+        if(bits == 64)
+            x = ((const uint64_t*)data)[i];
+        else
+            x = ((const uint32_t*)data)[i];
+
+        // Zigzag keeps small negative steps small
+        uint64_t delta = (x - prev) & mask;
+        uint64_t zz    = ((delta << 1) & mask) ^ ((delta >> (bits - 1)) ? mask : 0);
+
+        p    = internal_cvec_varint_put_(p, zz);
+        prev = x;
+    }
+
+    meta__->size = (uint64_t)(p - out);
+
+    return out;
+}
+
+// Decodes len bytes produced by internal_cvec_delta_encode_ with the same
+// width, returns the vector or NULL if the encoding is malformed
+static inline
+void* internal_cvec_delta_decode_(const void* src, size_t len, uint32_t bits)
+{
+    if(!src) return (NULL);
+
+    const uint8_t* p   = (const uint8_t*)src;
+    const uint8_t* end = p + len;
+
+    uint64_t mask = (bits == 64) ? UINT64_MAX : (((uint64_t)1 << bits) - 1);
+    uint64_t tag, n;
+
+    if(!internal_cvec_varint_get_(&p, end, 64, &tag) || tag != bits ||
+       !internal_cvec_varint_get_(&p, end, 64, &n))
+        return (NULL);
+
+    // Every element takes at least one byte, reject counts the input cannot hold
+    if(n > (uint64_t)(end - p))
+        return (NULL);
+
+    void* vec = cvec_reserve((size_t)(n ? n : 1), bits / 8, NULL);
+    if(!vec)
+        return (NULL);
+
+    uint64_t prev = 0;
+
+    for(uint64_t i = 0; i < n; i++)
+    {
+        uint64_t zz;
+        if(!internal_cvec_varint_get_(&p, end, bits, &zz))
+        {
+            cvec_free(vec);
+            return (NULL);
+        }
+
+        uint64_t delta = (zz >> 1) ^ ((zz & 1) ? mask : 0);
+        prev = (prev + delta) & mask;
+
+        if(bits == 64)
+            ((uint64_t*)vec)[i] = prev;
+        else
+            ((uint32_t*)vec)[i] = (uint32_t)prev;
+    }
+
+    INTERNAL_CVEC_GET_METADATA(vec)->size = n;
+
+    return vec;
+}
+
+#if defined(CVEC_HAS_FD_IO)
+#define INTERNAL_CVEC_DEFINE_DELTA_FD_(suffix, T, bits)                          \
+static inline                                                                    \
+int32_t cvec_write_fd_delta_##suffix(int fd, const T* vec)                       \
+{                                                                                \
+    uint8_t* enc = cvec_delta_encode_##suffix(vec);                              \
+    if(!enc) return 0;                                                           \
+                                                                                 \
+    int32_t ok = cvec_write_fd(fd, enc);                                         \
+    cvec_free(enc);                                                              \
+    return ok;                                                                   \
+}                                                                                \
+static inline                                                                    \
+T* cvec_read_fd_delta_##suffix(int fd)                                           \
+{                                                                                \
+    uint8_t* enc = (uint8_t*)cvec_read_fd(fd, 1, NULL);                          \
+    if(!enc) return (NULL);                                                      \
+                                                                                 \
+    T* vec = cvec_delta_decode_##suffix(enc, (size_t)cvec_get_sz(enc));          \
+    cvec_free(enc);                                                              \
+    return vec;                                                                  \
+}
+#else
+#define INTERNAL_CVEC_DEFINE_DELTA_FD_(suffix, T, bits)
+#endif
+
+#define INTERNAL_CVEC_DEFINE_DELTA_(suffix, T, bits)                             \
+static inline                                                                    \
+uint8_t* cvec_delta_encode_##suffix(const T* vec)                                \
+{                                                                                \
+    if(!vec || cvec_get_type_sz(vec) != sizeof(T)) return (NULL);                \
+    return internal_cvec_delta_encode_(vec, cvec_get_sz(vec), bits);             \
+}                                                                                \
+static inline                                                                    \
+T* cvec_delta_decode_##suffix(const void* src, size_t len)                       \
+{                                                                                \
+    return (T*)internal_cvec_delta_decode_(src, len, bits);                      \
+}                                                                                \
+INTERNAL_CVEC_DEFINE_DELTA_FD_(suffix, T, bits)
+
+INTERNAL_CVEC_DEFINE_DELTA_(i32, int32_t,  32)
+INTERNAL_CVEC_DEFINE_DELTA_(u32, uint32_t, 32)
+INTERNAL_CVEC_DEFINE_DELTA_(i64, int64_t,  64)
+INTERNAL_CVEC_DEFINE_DELTA_(u64, uint64_t, 64)
+
+
+// Search and reduction kernels.
+// cvec_find/cvec_count work on any vector comparing elements bytewise, 4 and
+// 8 byte elements take the SIMD paths. The typed variants (_i32, _u32, _i64,
+// _u64, _f32, _f64) use the C comparison of the type, min/max return 0 for
+// an empty vector and store the result in out otherwise.
+
+// Returned by the find functions when nothing matched
+#define CVEC_NPOS UINT64_MAX
+
+// Index of the lowest set bit, mask must not be 0
+static inline
+uint32_t internal_cvec_ctz32_(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(mask);
+#else
+    uint32_t i = 0;
+    while(!(mask & 1u)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+static inline
+uint64_t internal_cvec_find32_(const uint32_t* data, uint64_t n, uint32_t key)
+{
+    uint64_t i = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256i k = _mm256_set1_epi32((int32_t)key);
+
+    // 16 lanes per iteration, early exit on the first hit
+    for(; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 8));
+
+        uint32_t ma = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, k)));
+        uint32_t mb = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(b, k)));
+
+        uint32_t mask = ma | (mb << 8);
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128i k = _mm_set1_epi32((int32_t)key);
+
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32_t mask = 0;
+        for(uint32_t j = 0; j < 4; j++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i + 4*j));
+            mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, k))) << (4*j);
+        }
+
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_NEON)
+    uint32x4_t k = vdupq_n_u32(key);
+
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32x4_t hit = vorrq_u32(vorrq_u32(vceqq_u32(vld1q_u32(data + i),      k),
+                                             vceqq_u32(vld1q_u32(data + i + 4),  k)),
+                                   vorrq_u32(vceqq_u32(vld1q_u32(data + i + 8),  k),
+                                             vceqq_u32(vld1q_u32(data + i + 12), k)));
+        if(vmaxvq_u32(hit))
+            break;
+    }
+#endif
+
+    for(; i < n; i++)
+        if(data[i] == key)
+            return i;
+
+    return CVEC_NPOS;
+}
+
+static inline
+uint64_t internal_cvec_count32_(const uint32_t* data, uint64_t n, uint32_t key)
+{
+    uint64_t i     = 0;
+    uint64_t count = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256i k = _mm256_set1_epi32((int32_t)key);
+
+    while(i + 8 <= n)
+    {
+        // Lane counters are flushed before they can overflow
+        __m256i  acc = _mm256_setzero_si256();
+        uint64_t end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 8 <= end; i += 8)
+            acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i)), k));
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for(uint32_t j = 0; j < 8; j++)
+            count += lanes[j];
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128i k = _mm_set1_epi32((int32_t)key);
+
+    while(i + 4 <= n)
+    {
+        __m128i  acc = _mm_setzero_si128();
+        uint64_t end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 4 <= end; i += 4)
+            acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i)), k));
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        for(uint32_t j = 0; j < 4; j++)
+            count += lanes[j];
+    }
+#elif defined(CVEC_SIMD_NEON)
+    uint32x4_t k = vdupq_n_u32(key);
+
+    while(i + 4 <= n)
+    {
+        uint32x4_t acc = vdupq_n_u32(0);
+        uint64_t   end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 4 <= end; i += 4)
+            acc = vsubq_u32(acc, vceqq_u32(vld1q_u32(data + i), k));
+
+        count += vaddlvq_u32(acc);
+    }
+#endif
+
+    for(; i < n; i++)
+        count += (data[i] == key);
+
+    return count;
+}
+
+#if defined(CVEC_SIMD_SSE2)
+// SSE2 has no 64 bit compare: both 32 bit halves must match
+static inline
+__m128i internal_cvec_sse2_cmpeq_epi64_(__m128i a, __m128i b)
+{
+    __m128i eq = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+#endif
+
+static inline
+uint64_t internal_cvec_find64_(const uint64_t* data, uint64_t n, uint64_t key)
+{
+    uint64_t i = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256i k = _mm256_set1_epi64x((int64_t)key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 4));
+
+        uint32_t ma = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, k)));
+        uint32_t mb = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(b, k)));
+
+        uint32_t mask = ma | (mb << 4);
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128i k = _mm_set1_epi64x((int64_t)key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint32_t mask = 0;
+        for(uint32_t j = 0; j < 4; j++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i + 2*j));
+            mask |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(internal_cvec_sse2_cmpeq_epi64_(v, k))) << (2*j);
+        }
+
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_NEON)
+    uint64x2_t k = vdupq_n_u64(key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint64x2_t hit = vorrq_u64(vorrq_u64(vceqq_u64(vld1q_u64(data + i),     k),
+                                             vceqq_u64(vld1q_u64(data + i + 2), k)),
+                                   vorrq_u64(vceqq_u64(vld1q_u64(data + i + 4), k),
+                                             vceqq_u64(vld1q_u64(data + i + 6), k)));
+        if(vmaxvq_u32(vreinterpretq_u32_u64(hit)))
+            break;
+    }
+#endif
+
+    for(; i < n; i++)
+        if(data[i] == key)
+            return i;
+
+    return CVEC_NPOS;
+}
+
+static inline
+uint64_t internal_cvec_count64_(const uint64_t* data, uint64_t n, uint64_t key)
+{
+    uint64_t i     = 0;
+    uint64_t count = 0;
+
+    // 64 bit lane counters cannot overflow
+#if defined(CVEC_SIMD_AVX2)
+    __m256i k   = _mm256_set1_epi64x((int64_t)key);
+    __m256i acc = _mm256_setzero_si256();
+
+    for(; i + 4 <= n; i += 4)
+        acc = _mm256_sub_epi64(acc, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(data + i)), k));
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(CVEC_SIMD_SSE2)
+    __m128i k   = _mm_set1_epi64x((int64_t)key);
+    __m128i acc = _mm_setzero_si128();
+
+    for(; i + 2 <= n; i += 2)
+        acc = _mm_sub_epi64(acc, internal_cvec_sse2_cmpeq_epi64_(_mm_loadu_si128((const __m128i*)(data + i)), k));
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    count = lanes[0] + lanes[1];
+#elif defined(CVEC_SIMD_NEON)
+    uint64x2_t k   = vdupq_n_u64(key);
+    uint64x2_t acc = vdupq_n_u64(0);
+
+    for(; i + 2 <= n; i += 2)
+        acc = vsubq_u64(acc, vceqq_u64(vld1q_u64(data + i), k));
+
+    count = vaddvq_u64(acc);
+#endif
+
+    for(; i < n; i++)
+        count += (data[i] == key);
+
+    return count;
+}
+
+
+// Float find/count compare with == (-0.0 matches 0.0, NaN never matches)
+static inline
+uint64_t internal_cvec_find_f32_(const float* data, uint64_t n, float key)
+{
+    uint64_t i = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256 k = _mm256_set1_ps(key);
+
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32_t ma = (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(data + i),     k, _CMP_EQ_OQ));
+        uint32_t mb = (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(data + i + 8), k, _CMP_EQ_OQ));
+
+        uint32_t mask = ma | (mb << 8);
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128 k = _mm_set1_ps(key);
+
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32_t mask = 0;
+        for(uint32_t j = 0; j < 4; j++)
+            mask |= (uint32_t)_mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(data + i + 4*j), k)) << (4*j);
+
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_NEON)
+    float32x4_t k = vdupq_n_f32(key);
+
+    for(; i + 16 <= n; i += 16)
+    {
+        uint32x4_t hit = vorrq_u32(vorrq_u32(vceqq_f32(vld1q_f32(data + i),      k),
+                                             vceqq_f32(vld1q_f32(data + i + 4),  k)),
+                                   vorrq_u32(vceqq_f32(vld1q_f32(data + i + 8),  k),
+                                             vceqq_f32(vld1q_f32(data + i + 12), k)));
+        if(vmaxvq_u32(hit))
+            break;
+    }
+#endif
+
+    for(; i < n; i++)
+        if(data[i] == key)
+            return i;
+
+    return CVEC_NPOS;
+}
+
+static inline
+uint64_t internal_cvec_count_f32_(const float* data, uint64_t n, float key)
+{
+    uint64_t i     = 0;
+    uint64_t count = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256 k = _mm256_set1_ps(key);
+
+    while(i + 8 <= n)
+    {
+        // Lane counters are flushed before they can overflow
+        __m256i  acc = _mm256_setzero_si256();
+        uint64_t end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 8 <= end; i += 8)
+            acc = _mm256_sub_epi32(acc, _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(data + i), k, _CMP_EQ_OQ)));
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for(uint32_t j = 0; j < 8; j++)
+            count += lanes[j];
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128 k = _mm_set1_ps(key);
+
+    while(i + 4 <= n)
+    {
+        __m128i  acc = _mm_setzero_si128();
+        uint64_t end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 4 <= end; i += 4)
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(data + i), k)));
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        for(uint32_t j = 0; j < 4; j++)
+            count += lanes[j];
+    }
+#elif defined(CVEC_SIMD_NEON)
+    float32x4_t k = vdupq_n_f32(key);
+
+    while(i + 4 <= n)
+    {
+        uint32x4_t acc = vdupq_n_u32(0);
+        uint64_t   end = (n - i > ((uint64_t)1 << 32)) ? i + ((uint64_t)1 << 32) : n;
+
+        for(; i + 4 <= end; i += 4)
+            acc = vsubq_u32(acc, vceqq_f32(vld1q_f32(data + i), k));
+
+        count += vaddlvq_u32(acc);
+    }
+#endif
+
+    for(; i < n; i++)
+        count += (data[i] == key);
+
+    return count;
+}
+
+static inline
+uint64_t internal_cvec_find_f64_(const double* data, uint64_t n, double key)
+{
+    uint64_t i = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256d k = _mm256_set1_pd(key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint32_t ma = (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i),     k, _CMP_EQ_OQ));
+        uint32_t mb = (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i + 4), k, _CMP_EQ_OQ));
+
+        uint32_t mask = ma | (mb << 4);
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_SSE2)
+    __m128d k = _mm_set1_pd(key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint32_t mask = 0;
+        for(uint32_t j = 0; j < 4; j++)
+            mask |= (uint32_t)_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(data + i + 2*j), k)) << (2*j);
+
+        if(mask)
+            return i + internal_cvec_ctz32_(mask);
+    }
+#elif defined(CVEC_SIMD_NEON)
+    float64x2_t k = vdupq_n_f64(key);
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint64x2_t hit = vorrq_u64(vorrq_u64(vceqq_f64(vld1q_f64(data + i),     k),
+                                             vceqq_f64(vld1q_f64(data + i + 2), k)),
+                                   vorrq_u64(vceqq_f64(vld1q_f64(data + i + 4), k),
+                                             vceqq_f64(vld1q_f64(data + i + 6), k)));
+        if(vmaxvq_u32(vreinterpretq_u32_u64(hit)))
+            break;
+    }
+#endif
+
+    for(; i < n; i++)
+        if(data[i] == key)
+            return i;
+
+    return CVEC_NPOS;
+}
+
+static inline
+uint64_t internal_cvec_count_f64_(const double* data, uint64_t n, double key)
+{
+    uint64_t i     = 0;
+    uint64_t count = 0;
+
+#if defined(CVEC_SIMD_AVX2)
+    __m256d k   = _mm256_set1_pd(key);
+    __m256i acc = _mm256_setzero_si256();
+
+    for(; i + 4 <= n; i += 4)
+        acc = _mm256_sub_epi64(acc, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(data + i), k, _CMP_EQ_OQ)));
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(CVEC_SIMD_SSE2)
+    __m128d k   = _mm_set1_pd(key);
+    __m128i acc = _mm_setzero_si128();
+
+    for(; i + 2 <= n; i += 2)
+        acc = _mm_sub_epi64(acc, _mm_castpd_si128(_mm_cmpeq_pd(_mm_loadu_pd(data + i), k)));
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    count = lanes[0] + lanes[1];
+#elif defined(CVEC_SIMD_NEON)
+    float64x2_t k   = vdupq_n_f64(key);
+    uint64x2_t  acc = vdupq_n_u64(0);
+
+    for(; i + 2 <= n; i += 2)
+        acc = vsubq_u64(acc, vceqq_f64(vld1q_f64(data + i), k));
+
+    count = vaddvq_u64(acc);
+#endif
+
+    for(; i < n; i++)
+        count += (data[i] == key);
+
+    return count;
+}
+
+
+// Lane-wise min/max steps, OP(x, m) keeps m unless x is strictly better.
+// That matches the scalar `x < m ? x : m`, NaN in x never wins. Which of
+// -0.0 and 0.0 is returned when both are present is unspecified.
+#if defined(CVEC_SIMD_AVX2)
+static inline
+__m256i internal_cvec_avx2_min_epi64_(__m256i x, __m256i m)
+{
+    return _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+}
+
+static inline
+__m256i internal_cvec_avx2_max_epi64_(__m256i x, __m256i m)
+{
+    return _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+}
+
+// Unsigned compares flip the sign bits first
+static inline
+__m256i internal_cvec_avx2_min_epu64_(__m256i x, __m256i m)
+{
+    __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    return _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(_mm256_xor_si256(m, sign), _mm256_xor_si256(x, sign)));
+}
+
+static inline
+__m256i internal_cvec_avx2_max_epu64_(__m256i x, __m256i m)
+{
+    __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    return _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(_mm256_xor_si256(x, sign), _mm256_xor_si256(m, sign)));
+}
+#elif defined(CVEC_SIMD_SSE2)
+// SSE2 has no 32 bit min/max, select through a compare mask
+static inline
+__m128i internal_cvec_sse2_select_(__m128i mask, __m128i x, __m128i m)
+{
+    return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, m));
+}
+
+static inline
+__m128i internal_cvec_sse2_min_epi32_(__m128i x, __m128i m)
+{
+    return internal_cvec_sse2_select_(_mm_cmplt_epi32(x, m), x, m);
+}
+
+static inline
+__m128i internal_cvec_sse2_max_epi32_(__m128i x, __m128i m)
+{
+    return internal_cvec_sse2_select_(_mm_cmpgt_epi32(x, m), x, m);
+}
+
+static inline
+__m128i internal_cvec_sse2_min_epu32_(__m128i x, __m128i m)
+{
+    __m128i sign = _mm_set1_epi32(INT32_MIN);
+    return internal_cvec_sse2_select_(_mm_cmplt_epi32(_mm_xor_si128(x, sign), _mm_xor_si128(m, sign)), x, m);
+}
+
+static inline
+__m128i internal_cvec_sse2_max_epu32_(__m128i x, __m128i m)
+{
+    __m128i sign = _mm_set1_epi32(INT32_MIN);
+    return internal_cvec_sse2_select_(_mm_cmpgt_epi32(_mm_xor_si128(x, sign), _mm_xor_si128(m, sign)), x, m);
+}
+#elif defined(CVEC_SIMD_NEON)
+// vminq/vmaxq on floats return NaN if either lane is NaN, select instead
+#define INTERNAL_CVEC_NEON_PICK_(name, VT, cmp, bsl)                            \
+static inline                                                                   \
+VT name(VT x, VT m)                                                             \
+{                                                                               \
+    return bsl(cmp(x, m), x, m);                                                \
+}
+
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_min_s64_, int64x2_t,   vcltq_s64, vbslq_s64)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_max_s64_, int64x2_t,   vcgtq_s64, vbslq_s64)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_min_u64_, uint64x2_t,  vcltq_u64, vbslq_u64)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_max_u64_, uint64x2_t,  vcgtq_u64, vbslq_u64)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_min_f32_, float32x4_t, vcltq_f32, vbslq_f32)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_max_f32_, float32x4_t, vcgtq_f32, vbslq_f32)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_min_f64_, float64x2_t, vcltq_f64, vbslq_f64)
+INTERNAL_CVEC_NEON_PICK_(internal_cvec_neon_max_f64_, float64x2_t, vcgtq_f64, vbslq_f64)
+#endif
+
+// Loads and stores through untyped pointers for the integer vector types
+#define INTERNAL_CVEC_LOAD256_(p)     _mm256_loadu_si256((const __m256i*)(const void*)(p))
+#define INTERNAL_CVEC_STORE256_(p, v) _mm256_storeu_si256((__m256i*)(void*)(p), (v))
+#define INTERNAL_CVEC_LOAD128_(p)     _mm_loadu_si128((const __m128i*)(const void*)(p))
+#define INTERNAL_CVEC_STORE128_(p, v) _mm_storeu_si128((__m128i*)(void*)(p), (v))
+#define INTERNAL_CVEC_LT_(a, b)       ((a) < (b))
+#define INTERNAL_CVEC_GT_(a, b)       ((a) > (b))
+
+// Extremum of n >= 1 elements: two accumulators of LANES lanes, folded with
+// the scalar rule BETTER, then the scalar tail
+#define INTERNAL_CVEC_DEFINE_EXTREMUM_(name, T, VT, LANES, LOAD, STORE, SET1, OP, BETTER) \
+static inline                                                                   \
+T name(const T* data, uint64_t n)                                               \
+{                                                                               \
+    T        m = data[0];                                                       \
+    uint64_t i = 0;                                                             \
+                                                                                \
+    if(n >= 2 * (LANES))                                                        \
+    {                                                                           \
+        VT a = SET1(m);                                                         \
+        VT b = a;                                                               \
+                                                                                \
+        for(; i + 2 * (LANES) <= n; i += 2 * (LANES))                           \
+        {                                                                       \
+            a = OP(LOAD(data + i), a);                                          \
+            b = OP(LOAD(data + i + (LANES)), b);                                \
+        }                                                                       \
+                                                                                \
+        T lanes[2 * (LANES)];                                                   \
+        STORE(lanes, a);                                                        \
+        STORE(lanes + (LANES), b);                                              \
+                                                                                \
+        for(uint32_t j = 0; j < 2 * (LANES); j++)                               \
+            m = BETTER(lanes[j], m) ? lanes[j] : m;                             \
+    }                                                                           \
+                                                                                \
+    for(; i < n; i++)                                                           \
+        m = BETTER(data[i], m) ? data[i] : m;                                   \
+                                                                                \
+    return m;                                                                   \
+}
+
+#define INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(name, T, BETTER)                  \
+static inline                                                                   \
+T name(const T* data, uint64_t n)                                               \
+{                                                                               \
+    T m = data[0];                                                              \
+    for(uint64_t i = 1; i < n; i++)                                             \
+        m = BETTER(data[i], m) ? data[i] : m;                                   \
+    return m;                                                                   \
+}
+
+#if defined(CVEC_SIMD_AVX2)
+#define INTERNAL_CVEC_SET1_32x8_(x) _mm256_set1_epi32((int32_t)(x))
+#define INTERNAL_CVEC_SET1_64x4_(x) _mm256_set1_epi64x((int64_t)(x))
+
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_i32_, int32_t,  __m256i, 8, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_32x8_, _mm256_min_epi32, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_i32_, int32_t,  __m256i, 8, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_32x8_, _mm256_max_epi32, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_u32_, uint32_t, __m256i, 8, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_32x8_, _mm256_min_epu32, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_u32_, uint32_t, __m256i, 8, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_32x8_, _mm256_max_epu32, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_i64_, int64_t,  __m256i, 4, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_64x4_, internal_cvec_avx2_min_epi64_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_i64_, int64_t,  __m256i, 4, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_64x4_, internal_cvec_avx2_max_epi64_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_u64_, uint64_t, __m256i, 4, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_64x4_, internal_cvec_avx2_min_epu64_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_u64_, uint64_t, __m256i, 4, INTERNAL_CVEC_LOAD256_, INTERNAL_CVEC_STORE256_, INTERNAL_CVEC_SET1_64x4_, internal_cvec_avx2_max_epu64_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f32_, float,    __m256,  8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256_min_ps, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f32_, float,    __m256,  8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256_max_ps, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f64_, double,   __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_min_pd, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f64_, double,   __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_max_pd, INTERNAL_CVEC_GT_)
+#elif defined(CVEC_SIMD_SSE2)
+#define INTERNAL_CVEC_SET1_32x4_(x) _mm_set1_epi32((int32_t)(x))
+
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_i32_, int32_t,  __m128i, 4, INTERNAL_CVEC_LOAD128_, INTERNAL_CVEC_STORE128_, INTERNAL_CVEC_SET1_32x4_, internal_cvec_sse2_min_epi32_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_i32_, int32_t,  __m128i, 4, INTERNAL_CVEC_LOAD128_, INTERNAL_CVEC_STORE128_, INTERNAL_CVEC_SET1_32x4_, internal_cvec_sse2_max_epi32_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_u32_, uint32_t, __m128i, 4, INTERNAL_CVEC_LOAD128_, INTERNAL_CVEC_STORE128_, INTERNAL_CVEC_SET1_32x4_, internal_cvec_sse2_min_epu32_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_u32_, uint32_t, __m128i, 4, INTERNAL_CVEC_LOAD128_, INTERNAL_CVEC_STORE128_, INTERNAL_CVEC_SET1_32x4_, internal_cvec_sse2_max_epu32_, INTERNAL_CVEC_GT_)
+// SSE2 has no 64 bit compare, the 64 bit integer extremums stay scalar
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_i64_, int64_t,  INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_i64_, int64_t,  INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_u64_, uint64_t, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_u64_, uint64_t, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f32_, float,    __m128,  4, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps, _mm_min_ps, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f32_, float,    __m128,  4, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps, _mm_max_ps, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f64_, double,   __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_min_pd, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f64_, double,   __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_max_pd, INTERNAL_CVEC_GT_)
+#elif defined(CVEC_SIMD_NEON)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_i32_, int32_t,  int32x4_t,   4, vld1q_s32, vst1q_s32, vdupq_n_s32, vminq_s32, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_i32_, int32_t,  int32x4_t,   4, vld1q_s32, vst1q_s32, vdupq_n_s32, vmaxq_s32, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_u32_, uint32_t, uint32x4_t,  4, vld1q_u32, vst1q_u32, vdupq_n_u32, vminq_u32, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_u32_, uint32_t, uint32x4_t,  4, vld1q_u32, vst1q_u32, vdupq_n_u32, vmaxq_u32, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_i64_, int64_t,  int64x2_t,   2, vld1q_s64, vst1q_s64, vdupq_n_s64, internal_cvec_neon_min_s64_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_i64_, int64_t,  int64x2_t,   2, vld1q_s64, vst1q_s64, vdupq_n_s64, internal_cvec_neon_max_s64_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_u64_, uint64_t, uint64x2_t,  2, vld1q_u64, vst1q_u64, vdupq_n_u64, internal_cvec_neon_min_u64_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_u64_, uint64_t, uint64x2_t,  2, vld1q_u64, vst1q_u64, vdupq_n_u64, internal_cvec_neon_max_u64_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f32_, float,    float32x4_t, 4, vld1q_f32, vst1q_f32, vdupq_n_f32, internal_cvec_neon_min_f32_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f32_, float,    float32x4_t, 4, vld1q_f32, vst1q_f32, vdupq_n_f32, internal_cvec_neon_max_f32_, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_min_f64_, double,   float64x2_t, 2, vld1q_f64, vst1q_f64, vdupq_n_f64, internal_cvec_neon_min_f64_, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_(internal_cvec_max_f64_, double,   float64x2_t, 2, vld1q_f64, vst1q_f64, vdupq_n_f64, internal_cvec_neon_max_f64_, INTERNAL_CVEC_GT_)
+#else
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_i32_, int32_t,  INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_i32_, int32_t,  INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_u32_, uint32_t, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_u32_, uint32_t, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_i64_, int64_t,  INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_i64_, int64_t,  INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_u64_, uint64_t, INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_u64_, uint64_t, INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_f32_, float,    INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_f32_, float,    INTERNAL_CVEC_GT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_min_f64_, double,   INTERNAL_CVEC_LT_)
+INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_(internal_cvec_max_f64_, double,   INTERNAL_CVEC_GT_)
+#endif
+
+
+// Returns the index of the first element equal to elem, or CVEC_NPOS
+static inline
+uint64_t cvec_find(const void* vec, const void* elem)
+{
+    if(!vec || !elem) return CVEC_NPOS;
+
+    uint64_t sz      = cvec_get_sz(vec);
+    uint64_t elem_sz = cvec_get_type_sz(vec);
+
+    if(elem_sz == 4 || elem_sz == 8)
+    {
+        union { uint32_t u32; uint64_t u64; } key;
+        memcpy(&key, elem, elem_sz);
+
+        return (elem_sz == 4) ? internal_cvec_find32_((const uint32_t*)vec, sz, key.u32)
+                              : internal_cvec_find64_((const uint64_t*)vec, sz, key.u64);
+    }
+
+    const uint8_t* data = (const uint8_t*)vec;
+
+    for(uint64_t i = 0; i < sz; i++)
+        if(memcmp(data + i*elem_sz, elem, elem_sz) == 0)
+            return i;
+
+    return CVEC_NPOS;
+}
+
+// Returns the number of elements equal to elem
+static inline
+uint64_t cvec_count(const void* vec, const void* elem)
+{
+    if(!vec || !elem) return 0;
+
+    uint64_t sz      = cvec_get_sz(vec);
+    uint64_t elem_sz = cvec_get_type_sz(vec);
+
+    if(elem_sz == 4 || elem_sz == 8)
+    {
+        union { uint32_t u32; uint64_t u64; } key;
+        memcpy(&key, elem, elem_sz);
+
+        return (elem_sz == 4) ? internal_cvec_count32_((const uint32_t*)vec, sz, key.u32)
+                              : internal_cvec_count64_((const uint64_t*)vec, sz, key.u64);
+    }
+
+    const uint8_t* data  = (const uint8_t*)vec;
+    uint64_t       count = 0;
+
+    for(uint64_t i = 0; i < sz; i++)
+        count += (memcmp(data + i*elem_sz, elem, elem_sz) == 0);
+
+    return count;
+}
+
+
+// Integer find/count are bitwise, forward them to the lane kernels
+#define INTERNAL_CVEC_DEFINE_FIND_INT_(suffix, T, U, bits)                                         \
+static inline                                                                                      \
+uint64_t cvec_find_##suffix(const T* vec, T key)                                                   \
+{                                                                                                  \
+    return vec ? internal_cvec_find##bits##_((const U*)vec, cvec_get_sz(vec), (U)key) : CVEC_NPOS; \
+}                                                                                                  \
+static inline                                                                                      \
+uint64_t cvec_count_##suffix(const T* vec, T key)                                                  \
+{                                                                                                  \
+    return vec ? internal_cvec_count##bits##_((const U*)vec, cvec_get_sz(vec), (U)key) : 0;        \
+}
+
+// Floats compare with == (-0.0 matches 0.0, NaN never matches)
+#define INTERNAL_CVEC_DEFINE_FIND_FLOAT_(suffix, T)                             \
+static inline                                                                   \
+uint64_t cvec_find_##suffix(const T* vec, T key)                                \
+{                                                                               \
+    return vec ? internal_cvec_find_##suffix##_(vec, cvec_get_sz(vec), key) : CVEC_NPOS; \
+}                                                                               \
+static inline                                                                   \
+uint64_t cvec_count_##suffix(const T* vec, T key)                               \
+{                                                                               \
+    return vec ? internal_cvec_count_##suffix##_(vec, cvec_get_sz(vec), key) : 0; \
+}
+
+// min/max forward to the extremum kernels. Sums hoist the size and use 4
+// independent accumulators so the loop vectorizes without reassociation flags
+// for integers; float sums stay in order within each accumulator.
+#define INTERNAL_CVEC_DEFINE_REDUCE_(suffix, T, ACC)                            \
+static inline                                                                   \
+int32_t cvec_min_##suffix(const T* vec, T* out)                                 \
+{                                                                               \
+    uint64_t sz = cvec_get_sz(vec);                                             \
+    if(sz == 0 || !out) return 0;                                               \
+    *out = internal_cvec_min_##suffix##_(vec, sz);                              \
+    return 1;                                                                   \
+}                                                                               \
+static inline                                                                   \
+int32_t cvec_max_##suffix(const T* vec, T* out)                                 \
+{                                                                               \
+    uint64_t sz = cvec_get_sz(vec);                                             \
+    if(sz == 0 || !out) return 0;                                               \
+    *out = internal_cvec_max_##suffix##_(vec, sz);                              \
+    return 1;                                                                   \
+}                                                                               \
+static inline                                                                   \
+ACC cvec_sum_##suffix(const T* vec)                                             \
+{                                                                               \
+    uint64_t sz = cvec_get_sz(vec);                                             \
+    uint64_t i  = 0;                                                            \
+    ACC s0 = 0, s1 = 0, s2 = 0, s3 = 0;                                         \
+    for(; i + 4 <= sz; i += 4)                                                  \
+    {                                                                           \
+        s0 += (ACC)vec[i];     s1 += (ACC)vec[i + 1];                           \
+        s2 += (ACC)vec[i + 2]; s3 += (ACC)vec[i + 3];                           \
+    }                                                                           \
+    for(; i < sz; i++)                                                          \
+        s0 += (ACC)vec[i];                                                      \
+    return (s0 + s1) + (s2 + s3);                                               \
+}
+
+INTERNAL_CVEC_DEFINE_FIND_INT_(i32, int32_t,  uint32_t, 32)
+INTERNAL_CVEC_DEFINE_FIND_INT_(u32, uint32_t, uint32_t, 32)
+INTERNAL_CVEC_DEFINE_FIND_INT_(i64, int64_t,  uint64_t, 64)
+INTERNAL_CVEC_DEFINE_FIND_INT_(u64, uint64_t, uint64_t, 64)
+INTERNAL_CVEC_DEFINE_FIND_FLOAT_(f32, float)
+INTERNAL_CVEC_DEFINE_FIND_FLOAT_(f64, double)
+
+INTERNAL_CVEC_DEFINE_REDUCE_(i32, int32_t,  int64_t)
+INTERNAL_CVEC_DEFINE_REDUCE_(u32, uint32_t, uint64_t)
+INTERNAL_CVEC_DEFINE_REDUCE_(i64, int64_t,  int64_t)
+INTERNAL_CVEC_DEFINE_REDUCE_(u64, uint64_t, uint64_t)
+INTERNAL_CVEC_DEFINE_REDUCE_(f32, float,    float)
+INTERNAL_CVEC_DEFINE_REDUCE_(f64, double,   double)
+
+
+// Sorting and binary search.
+// The typed sorts (_u32, _i32, _u64, _i64, _f32, _f64) are LSD radix sorts
+// that skip passes where every key shares the digit, cvec_sort_by_key radix
+// sorts records on a key field and cvec_sort falls back to qsort. The radix
+// paths need a scratch buffer from the vector's allocator; they return 0 and
+// leave the vector untouched if it cannot be allocated, 1 otherwise.
+
+// typedef of comparator, qsort style
+typedef int (*cvec_compare_fn)(const void* a, const void* b);
+
+// How the key bytes of a record are interpreted
+typedef enum
+{
+    CVEC_KEY_UNSIGNED = 0,
+    CVEC_KEY_SIGNED,
+    CVEC_KEY_FLOAT           // IEEE float (size 4) or double (size 8)
+} cvec_key_kind;
+
+// Key field of a record for cvec_sort_by_key, size is 1, 2, 4 or 8 bytes
+typedef struct
+{
+    uint64_t      offset;
+    uint32_t      size;
+    cvec_key_kind kind;
+} cvec_sort_key;
+
+// Radix sorts below this size use insertion sort
+#define INTERNAL_CVEC_RADIX_MIN 64
+
+typedef struct
+{
+    uint64_t key;
+    uint64_t index;
+} internal_cvec_key_index_;
+
+#define INTERNAL_CVEC_KEY_SELF_(x)  (x)
+#define INTERNAL_CVEC_KEY_PAIR_(x)  ((x).key)
+
+// Stable LSD radix sort on the low passes bytes of KEY, tmp holds n elements
+#define INTERNAL_CVEC_DEFINE_RADIX_(name, T, KEY)                                \
+static inline                                                                    \
+void internal_cvec_radix_##name##_(T* data, T* tmp, uint64_t n, uint32_t passes) \
+{                                                                                \
+    if(n < INTERNAL_CVEC_RADIX_MIN)                                              \
+    {                                                                            \
+        for(uint64_t i = 1; i < n; i++)                                          \
+        {                                                                        \
+            T        x = data[i];                                                \
+            uint64_t j = i;                                                      \
+            for(; j > 0 && KEY(data[j - 1]) > KEY(x); j--)                       \
+                data[j] = data[j - 1];                                           \
+            data[j] = x;                                                         \
+        }                                                                        \
+        return ;                                                                 \
+    }                                                                            \
+                                                                                 \
+    uint64_t counts[8][256];                                                     \
+    memset(counts, 0, sizeof(counts));                                           \
+                                                                                 \
+    /* one histogram pass for every digit */                                     \
+    for(uint64_t i = 0; i < n; i++)                                              \
+    {                                                                            \
+        uint64_t k = (uint64_t)KEY(data[i]);                                     \
+        for(uint32_t p = 0; p < passes; p++)                                     \
+            counts[p][(k >> (8*p)) & 0xFF]++;                                    \
+    }                                                                            \
+                                                                                 \
+    T* src = data;                                                               \
+    T* dst = tmp;                                                                \
+                                                                                 \
+    for(uint32_t p = 0; p < passes; p++)                                         \
+    {                                                                            \
+        uint64_t* c = counts[p];                                                 \
+                                                                                 \
+        /* every key has the same digit, nothing to move */                      \
+        if(c[((uint64_t)KEY(src[0]) >> (8*p)) & 0xFF] == n)                      \
+            continue;                                                            \
+                                                                                 \
+        uint64_t sum = 0;                                                        \
+        for(uint32_t b = 0; b < 256; b++)                                        \
+        {                                                                        \
+            uint64_t t = c[b];                                                   \
+            c[b] = sum;                                                          \
+            sum += t;                                                            \
+        }                                                                        \
+                                                                                 \
+        for(uint64_t i = 0; i < n; i++)                                          \
+            dst[c[((uint64_t)KEY(src[i]) >> (8*p)) & 0xFF]++] = src[i];          \
+                                                                                 \
+        T* swap = src; src = dst; dst = swap;                                    \
+    }                                                                            \
+                                                                                 \
+    if(src != data)                                                              \
+        memcpy(data, src, n * sizeof(T));                                        \
+}
+
+INTERNAL_CVEC_DEFINE_RADIX_(u32,  uint32_t,                 INTERNAL_CVEC_KEY_SELF_)
+INTERNAL_CVEC_DEFINE_RADIX_(u64,  uint64_t,                 INTERNAL_CVEC_KEY_SELF_)
+INTERNAL_CVEC_DEFINE_RADIX_(pair, internal_cvec_key_index_, INTERNAL_CVEC_KEY_PAIR_)
+
+
+// Order preserving maps from signed/float bit patterns to unsigned keys
+static inline uint32_t internal_cvec_key_i32_(uint32_t x)   { return x ^ 0x80000000u; }
+static inline uint64_t internal_cvec_key_i64_(uint64_t x)   { return x ^ 0x8000000000000000ull; }
+static inline uint32_t internal_cvec_key_f32_(uint32_t x)   { return (x & 0x80000000u) ? ~x : (x | 0x80000000u); }
+static inline uint64_t internal_cvec_key_f64_(uint64_t x)   { return (x & 0x8000000000000000ull) ? ~x : (x | 0x8000000000000000ull); }
+static inline uint32_t internal_cvec_unkey_f32_(uint32_t x) { return (x & 0x80000000u) ? (x & ~0x80000000u) : ~x; }
+static inline uint64_t internal_cvec_unkey_f64_(uint64_t x) { return (x & 0x8000000000000000ull) ? (x & ~0x8000000000000000ull) : ~x; }
+
+// Radix sorts n 32/64-bit words in place, kind picks the key mapping
+static inline
+int32_t internal_cvec_radix_words_(void* vec, uint32_t word_sz, cvec_key_kind kind)
+{
+    if(!vec) return 1;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t n       = meta__->size;
+    uint64_t bytes   = n * word_sz;
+    void*    scratch = NULL;
+
+    if(n < 2) return 1;
+
+    if(n >= INTERNAL_CVEC_RADIX_MIN)
+    {
+        scratch = internal_cvec_mem_alloc_(meta__->allocator, bytes, 0);
+        if(!scratch)
+            return 0;
+    }
+
+    if(word_sz == 4)
+    {
+        uint32_t* data = (uint32_t*)vec;
+
+        if(kind == CVEC_KEY_SIGNED)     for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_i32_(data[i]);
+        else if(kind == CVEC_KEY_FLOAT) for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_f32_(data[i]);
+
+        internal_cvec_radix_u32_(data, (uint32_t*)scratch, n, 4);
+
+        if(kind == CVEC_KEY_SIGNED)     for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_i32_(data[i]);
+        else if(kind == CVEC_KEY_FLOAT) for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_unkey_f32_(data[i]);
+    }
+    else
+    {
+        uint64_t* data = (uint64_t*)vec;
+
+        if(kind == CVEC_KEY_SIGNED)     for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_i64_(data[i]);
+        else if(kind == CVEC_KEY_FLOAT) for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_f64_(data[i]);
+
+        internal_cvec_radix_u64_(data, (uint64_t*)scratch, n, 8);
+
+        if(kind == CVEC_KEY_SIGNED)     for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_key_i64_(data[i]);
+        else if(kind == CVEC_KEY_FLOAT) for(uint64_t i = 0; i < n; i++) data[i] = internal_cvec_unkey_f64_(data[i]);
+    }
+
+    if(scratch)
+        internal_cvec_mem_free_(meta__->allocator, scratch, bytes);
+
+    return 1;
+}
+
+static inline int32_t cvec_sort_u32(uint32_t* vec) { return internal_cvec_radix_words_(vec, 4, CVEC_KEY_UNSIGNED); }
+static inline int32_t cvec_sort_i32(int32_t*  vec) { return internal_cvec_radix_words_(vec, 4, CVEC_KEY_SIGNED);   }
+static inline int32_t cvec_sort_f32(float*    vec) { return internal_cvec_radix_words_(vec, 4, CVEC_KEY_FLOAT);    }
+static inline int32_t cvec_sort_u64(uint64_t* vec) { return internal_cvec_radix_words_(vec, 8, CVEC_KEY_UNSIGNED); }
+static inline int32_t cvec_sort_i64(int64_t*  vec) { return internal_cvec_radix_words_(vec, 8, CVEC_KEY_SIGNED);   }
+static inline int32_t cvec_sort_f64(double*   vec) { return internal_cvec_radix_words_(vec, 8, CVEC_KEY_FLOAT);    }
+
+
+// Reads the key of a record as an order preserving unsigned value
+static inline
+uint64_t internal_cvec_read_key_(const uint8_t* elem, const cvec_sort_key* key)
+{
+    const uint8_t* p = elem + key->offset;
+
+    switch(key->size)
+    {
+        case 1:
+        {
+            uint8_t v; memcpy(&v, p, 1);
+            return (key->kind == CVEC_KEY_SIGNED) ? (uint8_t)(v ^ 0x80u) : v;
+        }
+        case 2:
+        {
+            uint16_t v; memcpy(&v, p, 2);
+            return (key->kind == CVEC_KEY_SIGNED) ? (uint16_t)(v ^ 0x8000u) : v;
+        }
+        case 4:
+        {
+            uint32_t v; memcpy(&v, p, 4);
+            if(key->kind == CVEC_KEY_SIGNED) return internal_cvec_key_i32_(v);
+            if(key->kind == CVEC_KEY_FLOAT)  return internal_cvec_key_f32_(v);
+            return v;
+        }
+        default:
+        {
+            uint64_t v; memcpy(&v, p, 8);
+            if(key->kind == CVEC_KEY_SIGNED) return internal_cvec_key_i64_(v);
+            if(key->kind == CVEC_KEY_FLOAT)  return internal_cvec_key_f64_(v);
+            return v;
+        }
+    }
+}
+
+// Stable radix sort of records on the key field described by key.
+// (key, index) pairs are sorted first, then the records are permuted once.
+static inline
+int32_t cvec_sort_by_key(void* vec, const cvec_sort_key* key)
+{
+    if(!vec || !key) return 1;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    uint64_t n       = meta__->size;
+    uint64_t elem_sz = meta__->typesize;
+
+    if(n < 2) return 1;
+
+    if((key->size != 1 && key->size != 2 && key->size != 4 && key->size != 8) ||
+       key->offset + key->size > elem_sz)
+        return 0;
+
+    uint64_t pairs_bytes = 2 * n * sizeof(internal_cvec_key_index_);
+    uint64_t bytes       = pairs_bytes + n * elem_sz;
+
+    uint8_t* scratch = (uint8_t*)internal_cvec_mem_alloc_(meta__->allocator, bytes, 0);
+    if(!scratch)
+        return 0;
+
+    internal_cvec_key_index_* pairs = (internal_cvec_key_index_*)scratch;
+    uint8_t*                  data  = (uint8_t*)vec;
+    uint8_t*                  out   = scratch + pairs_bytes;
+
+    for(uint64_t i = 0; i < n; i++)
+    {
+        pairs[i].key   = internal_cvec_read_key_(data + i * elem_sz, key);
+        pairs[i].index = i;
+    }
+
+    internal_cvec_radix_pair_(pairs, pairs + n, n, key->size);
+
+    for(uint64_t i = 0; i < n; i++)
+        memcpy(out + i * elem_sz, data + pairs[i].index * elem_sz, elem_sz);
+
+    memcpy(data, out, n * elem_sz);
+
+    internal_cvec_mem_free_(meta__->allocator, scratch, bytes);
+
+    return 1;
+}
+
+// Sort the vector with a qsort style comparator
+static inline
+void cvec_sort(void* vec, cvec_compare_fn cmp)
+{
+    if(!vec || !cmp) return ;
+
+    qsort(vec, cvec_get_sz(vec), cvec_get_type_sz(vec), cmp);
+}
+
+
+// Returns the index of the first element not ordered before key by cmp
+static inline
+uint64_t cvec_lower_bound(const void* vec, const void* key, cvec_compare_fn cmp)
+{
+    if(!vec || !cmp) return 0;
+
+    const uint8_t* data    = (const uint8_t*)vec;
+    uint64_t       elem_sz = cvec_get_type_sz(vec);
+    uint64_t       lo      = 0;
+    uint64_t       len     = cvec_get_sz(vec);
+
+    while(len > 0)
+    {
+        uint64_t half = len / 2;
+
+        if(cmp(data + (lo + half) * elem_sz, key) < 0)
+        {
+            lo  += half + 1;
+            len -= half + 1;
+        }
+        else
+            len = half;
+    }
+
+    return lo;
+}
+
+// Returns the index of an element equal to key in a sorted vector, or CVEC_NPOS
+static inline
+uint64_t cvec_bsearch(const void* vec, const void* key, cvec_compare_fn cmp)
+{
+    uint64_t i = cvec_lower_bound(vec, key, cmp);
+
+    if(i < cvec_get_sz(vec) && cmp((const uint8_t*)vec + i * cvec_get_type_sz(vec), key) == 0)
+        return i;
+
+    return CVEC_NPOS;
+}
+
+// Branchless lower bound for the scalar types
+#define INTERNAL_CVEC_DEFINE_LOWER_BOUND_(suffix, T)                            \
+static inline                                                                   \
+uint64_t cvec_lower_bound_##suffix(const T* vec, T key)                         \
+{                                                                               \
+    uint64_t len = cvec_get_sz(vec);                                            \
+    if(len == 0) return 0;                                                      \
+                                                                                \
+    const T* base = vec;                                                        \
+    while(len > 1)                                                              \
+    {                                                                           \
+        uint64_t half = len / 2;                                                \
+        base = (base[half] < key) ? base + half : base;                         \
+        len -= half;                                                            \
+    }                                                                           \
+                                                                                \
+    return (uint64_t)(base - vec) + (*base < key);                              \
+}
+
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(u32, uint32_t)
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(i32, int32_t)
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(u64, uint64_t)
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(i64, int64_t)
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(f32, float)
+INTERNAL_CVEC_DEFINE_LOWER_BOUND_(f64, double)
+
+
+// Compact vectors for huge numbers of tiny vectors.
+// The header is 16 bytes (8 on 32-bit targets): 32-bit size/capacity plus a
+// pointer to a cvec_type shared by every vector of that type. They always
+// double on growth and use the INTERNAL_CVEC_* allocation funcs, they are not
+// interchangeable with regular cvecs.
+
+#define INTERNAL_CVEC_GET_COMPACT_METADATA(vec)\
+    ((internal_cvec_compact_metadata_*)((uint8_t*)(vec) - sizeof(internal_cvec_compact_metadata_)))
+
+// Shared per-type descriptor, must outlive every vector using it
+typedef struct
+{
+    uint64_t             typesize;
+    cvec_elem_destructor destructor;
+} cvec_type;
+
+#define CVEC_TYPE(T, destructor) { sizeof(T), (destructor) }
+
+typedef struct
+{
+    uint32_t         size;
+    uint32_t         capacity;
+    const cvec_type* type;
+} internal_cvec_compact_metadata_ ;
+
+
+// Returns the compact vector's size
+static inline
+uint64_t cvec_compact_get_sz(const void* vec)
+{
+    return vec ? (INTERNAL_CVEC_GET_COMPACT_METADATA(vec)->size) : (0);
+}
+
+// Returns the compact vector's capacity
+static inline
+uint64_t cvec_compact_get_capacity(const void* vec)
+{
+    return vec ? (INTERNAL_CVEC_GET_COMPACT_METADATA(vec)->capacity) : (0);
+}
+
+// Returns a compact vector with reserved space
+static inline
+void* cvec_compact_reserve(uint32_t capacity, const cvec_type* type)
+{
+    if(!type)
+        return (NULL);
+
+    if(type->typesize && capacity > (SIZE_MAX - sizeof(internal_cvec_compact_metadata_)) / type->typesize)
+        return (NULL);
+
+    internal_cvec_compact_metadata_* meta__ = (internal_cvec_compact_metadata_*)
+        INTERNAL_CVEC_CALLOC(1, sizeof(internal_cvec_compact_metadata_) + capacity * type->typesize);
+    if(!meta__)
+        return (NULL);
+
+    meta__->capacity = capacity;
+    meta__->type     = type;
+
+    return meta__ + 1;
+}
+
+// Returns a compact vector with capacity of 1
+static inline
+void* cvec_compact_create(const cvec_type* type)
+{
+    return cvec_compact_reserve(1, type);
+}
+
+// Push back an element in the compact vector
+static inline
+void* cvec_compact_push_back(void* vec, const void* elem)
+{
+    if(!vec)
+        return (NULL);
+
+    internal_cvec_compact_metadata_* meta__ = INTERNAL_CVEC_GET_COMPACT_METADATA(vec);
+
+    uint32_t sz       = meta__->size;
+    uint32_t capacity = meta__->capacity;
+    uint64_t elem_sz  = meta__->type->typesize;
+
+    if(capacity == sz)
+    {
+        if(capacity == UINT32_MAX)
+            return (NULL);
+
+        uint32_t new_capacity = (capacity == 0) ? 1 :
+                                (capacity > UINT32_MAX / 2) ? UINT32_MAX : capacity*2;
+
+        if(elem_sz && new_capacity > (SIZE_MAX - sizeof(internal_cvec_compact_metadata_)) / elem_sz)
+            return (NULL);
+
+        meta__ = (internal_cvec_compact_metadata_*)
+                 INTERNAL_CVEC_REALLOC(meta__,
+                                        sizeof(internal_cvec_compact_metadata_) + new_capacity * elem_sz);
+        if(!meta__)
+            return (NULL);
+
+        // reset the memory to 0 after a point
+        vec = meta__ + 1;
+        memset((uint8_t*)vec + capacity * elem_sz, 0, (new_capacity - capacity) * elem_sz);
+
+        meta__->capacity = new_capacity;
+    }
+
+    memcpy((uint8_t*)vec + (sz * elem_sz), elem, elem_sz);
+    meta__->size++;
+
+    return vec;
+}
+
+// Erase an element from the compact vector
+static inline
+void cvec_compact_erase(void* vec, size_t index)
+{
+    if(!vec) return ;
+
+    internal_cvec_compact_metadata_* meta__ = INTERNAL_CVEC_GET_COMPACT_METADATA(vec);
+
+    uint64_t sz      = meta__->size;
+    uint64_t elem_sz = meta__->type->typesize;
+
+    uint8_t* data = (uint8_t*)vec;
+
+    // If out of bounds, do not erase anything
+    if(index >= sz) return ;
+
+    if(meta__->type->destructor)
+        meta__->type->destructor(data + index * elem_sz);
+
+    // Shift elements
+    memmove(data + index * elem_sz,
+            data + (index + 1)  * elem_sz,
+            (sz -  (index + 1)) * elem_sz);
+
+    meta__->size--;
+}
+
+// Free the compact vector and its metadata
+static inline
+void cvec_compact_free(void* vec)
+{
+    if(!vec) return ;
+
+    internal_cvec_compact_metadata_* meta__ = INTERNAL_CVEC_GET_COMPACT_METADATA(vec);
+
+    cvec_elem_destructor destructor = meta__->type->destructor;
+    uint64_t             elem_sz    = meta__->type->typesize;
+
+    if(destructor)
+    {
+        uint8_t* data = (uint8_t*) vec;
+
+        for(uint64_t i = 0; i < meta__->size; i++)
             destructor(data + i*elem_sz);
     }
 
-    INTERNAL_CVEC_FREE(meta__);
-    return ;
+    INTERNAL_CVEC_FREE(meta__);
+}
+
+
+// Typed front-end, CVEC_DEFINE(name, T) generates name_create, name_reserve,
+// name_push_back, name_at, name_erase, name_size and name_free working on T*.
+// The element size is a compile time constant so copies become plain stores
+// and loops vectorize. The vectors are regular cvecs and can be mixed with
+// the generic API.
+#define CVEC_DEFINE(name, T)                                                     \
+static inline                                                                    \
+T* name##_reserve(size_t capacity, cvec_elem_destructor destructor)              \
+{                                                                                \
+    return (T*)cvec_reserve(capacity, sizeof(T), destructor);                    \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+T* name##_create(cvec_elem_destructor destructor)                                \
+{                                                                                \
+    return (T*)cvec_reserve(1, sizeof(T), destructor);                           \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+uint64_t name##_size(const T* vec)                                               \
+{                                                                                \
+    return vec ? internal_cvec_meta_(vec)->size : 0;                             \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+T* name##_push_back(T* vec, T elem)                                              \
+{                                                                                \
+    if(!vec)                                                                     \
+        return (NULL);                                                           \
+                                                                                 \
+    internal_cvec_metadata_* meta__ = internal_cvec_meta_(vec);                  \
+                                                                                 \
+    if(meta__->size == meta__->capacity)                                         \
+    {                                                                            \
+        vec = (T*)internal_cvec_grow_(vec, meta__->size + 1);                    \
+        if(!vec)                                                                 \
+            return (NULL);                                                       \
+                                                                                 \
+        meta__ = internal_cvec_meta_(vec);                                       \
+    }                                                                            \
+                                                                                 \
+    vec[meta__->size++] = elem;                                                  \
+                                                                                 \
+    return vec;                                                                  \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+T* name##_at(T* vec, size_t index)                                               \
+{                                                                                \
+    return (vec && index < internal_cvec_meta_(vec)->size) ? vec + index : NULL; \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+void name##_erase(T* vec, size_t index)                                          \
+{                                                                                \
+    if(!vec) return ;                                                            \
+                                                                                 \
+    internal_cvec_metadata_* meta__ = internal_cvec_meta_(vec);                  \
+                                                                                 \
+    uint64_t sz = meta__->size;                                                  \
+                                                                                 \
+    if(index >= sz) return ;                                                     \
+                                                                                 \
+    internal_cvec_destroy_range_(meta__, (uint8_t*)vec, index, 1);               \
+                                                                                 \
+    memmove(vec + index, vec + index + 1, (sz - (index + 1)) * sizeof(T));       \
+    INTERNAL_CVEC_STAT_ADD(meta__, memmove_bytes, (sz - index - 1) * sizeof(T)); \
+                                                                                 \
+    meta__->size--;                                                              \
+}                                                                                \
+                                                                                 \
+static inline                                                                    \
+void name##_free(T* vec)                                                         \
+{                                                                                \
+    cvec_free(vec);                                                              \
+}
+
+
+// Segmented vectors with stable element addresses.
+// Elements live in chunks of a power of two size behind a directory (itself
+// a cvec of chunk pointers), appending never moves existing elements and
+// indexing is a shift and a mask.
+
+#ifndef CVEC_SEG_CHUNK_BYTES
+#define CVEC_SEG_CHUNK_BYTES (64 * 1024)
+#endif
+
+typedef struct
+{
+    uint8_t**            chunks;        // cvec of chunk pointers
+    uint64_t             size;
+    uint64_t             typesize;
+    uint32_t             chunk_shift;   // a chunk holds 1 << chunk_shift elements
+    cvec_elem_destructor destructor;
+} cvec_seg;
+
+
+// Initializes an empty segmented vector. chunk_elems is rounded up to a power
+// of two, 0 picks about CVEC_SEG_CHUNK_BYTES per chunk. Returns 0 on failure.
+static inline
+int32_t cvec_seg_init(cvec_seg* seg, size_t elem_sz, size_t chunk_elems,
+                      cvec_elem_destructor destructor)
+{
+    if(!seg || elem_sz == 0) return 0;
+
+    if(chunk_elems == 0)
+        chunk_elems = (CVEC_SEG_CHUNK_BYTES / elem_sz) ? CVEC_SEG_CHUNK_BYTES / elem_sz : 1;
+
+    uint32_t shift = 0;
+    while(((uint64_t)1 << shift) < chunk_elems)
+        shift++;
+
+    seg->chunks      = (uint8_t**)cvec_create(sizeof(uint8_t*), NULL);
+    seg->size        = 0;
+    seg->typesize    = elem_sz;
+    seg->chunk_shift = shift;
+    seg->destructor  = destructor;
+
+    return seg->chunks != NULL;
+}
+
+// Returns the segmented vector's size
+static inline
+uint64_t cvec_seg_get_sz(const cvec_seg* seg)
+{
+    return seg ? seg->size : 0;
+}
+
+// Returns a pointer to the element at index, or NULL if out of bounds
+static inline
+void* cvec_seg_at(const cvec_seg* seg, uint64_t index)
+{
+    if(!seg || index >= seg->size)
+        return (NULL);
+
+    uint64_t mask = ((uint64_t)1 << seg->chunk_shift) - 1;
+
+    return seg->chunks[index >> seg->chunk_shift] + (index & mask) * seg->typesize;
+}
+
+// Push back an element, returns a pointer to the stored copy or NULL on failure
+static inline
+void* cvec_seg_push_back(cvec_seg* seg, const void* elem)
+{
+    if(!seg || !elem)
+        return (NULL);
+
+    uint64_t mask   = ((uint64_t)1 << seg->chunk_shift) - 1;
+    uint64_t offset = seg->size & mask;
+
+    // Start a new chunk, the old ones stay where they are
+    if(offset == 0 && (seg->size >> seg->chunk_shift) == cvec_get_sz(seg->chunks))
+    {
+        uint8_t* chunk = (uint8_t*)INTERNAL_CVEC_CALLOC((uint64_t)1 << seg->chunk_shift, seg->typesize);
+        if(!chunk)
+            return (NULL);
+
+        uint8_t** chunks = (uint8_t**)cvec_push_back(seg->chunks, &chunk);
+        if(!chunks)
+        {
+            INTERNAL_CVEC_FREE(chunk);
+            return (NULL);
+        }
+
+        seg->chunks = chunks;
+    }
+
+    uint8_t* slot = seg->chunks[seg->size >> seg->chunk_shift] + offset * seg->typesize;
+
+    memcpy(slot, elem, seg->typesize);
+    seg->size++;
+
+    return slot;
+}
+
+// Destroy the last element, its chunk is kept for reuse
+static inline
+void cvec_seg_pop_back(cvec_seg* seg)
+{
+    if(!seg || seg->size == 0) return ;
+
+    if(seg->destructor)
+        seg->destructor(cvec_seg_at(seg, seg->size - 1));
+
+    seg->size--;
+}
+
+// Destroy every element and free the chunks and the directory
+static inline
+void cvec_seg_free(cvec_seg* seg)
+{
+    if(!seg || !seg->chunks) return ;
+
+    uint64_t per_chunk = (uint64_t)1 << seg->chunk_shift;
+    uint64_t nchunks   = cvec_get_sz(seg->chunks);
+
+    for(uint64_t c = 0; c < nchunks; c++)
+    {
+        uint8_t* chunk = seg->chunks[c];
+
+        if(seg->destructor)
+        {
+            uint64_t first = c * per_chunk;
+            uint64_t live  = (seg->size > first) ? seg->size - first : 0;
+            if(live > per_chunk) live = per_chunk;
+
+            for(uint64_t i = 0; i < live; i++)
+                seg->destructor(chunk + i * seg->typesize);
+        }
+
+        INTERNAL_CVEC_FREE(chunk);
+    }
+
+    cvec_free(seg->chunks);
+
+    seg->chunks = NULL;
+    seg->size   = 0;
+}
+
+
+// Struct of arrays.
+// A cvec_soa stores each field of a record in its own column, a regular cvec,
+// so a scan over one field only pulls that field through the cache. The
+// columns grow in lockstep and can be handed as is to the search, sort and
+// parallel functions. Records are scattered on push and gathered on get
+// through a field table, usually built with CVEC_SOA_FIELD.
+
+typedef struct
+{
+    size_t offset;      // offset of the field in the record
+    size_t size;        // size of the field, the column's type size
+} cvec_soa_field;
+
+#define CVEC_SOA_FIELD(T, member) { offsetof(T, member), sizeof(((T*)0)->member) }
+
+typedef struct
+{
+    void**                columns;   // cvec of column vectors, one per field
+    const cvec_soa_field* fields;    // must outlive the container
+    uint32_t              nfields;
+} cvec_soa;
+
+
+// Initializes an empty container with one column per field, each created
+// with opts (may be NULL, e.g. an alignment for SIMD scans). Returns 0 on failure.
+static inline
+int32_t cvec_soa_init(cvec_soa* soa, const cvec_soa_field* fields, uint32_t nfields,
+                      const cvec_options* opts)
+{
+    if(!soa || !fields || nfields == 0) return 0;
+
+    soa->fields  = fields;
+    soa->nfields = 0;
+    soa->columns = (void**)cvec_reserve(nfields, sizeof(void*), NULL);
+    if(!soa->columns)
+        return 0;
+
+    for(uint32_t f = 0; f < nfields; f++)
+    {
+        void* column = fields[f].size ? cvec_create_ex(fields[f].size, NULL, opts) : NULL;
+        if(!column)
+            break;
+
+        soa->columns = (void**)cvec_push_back(soa->columns, &column);
+        soa->nfields++;
+    }
+
+    if(soa->nfields != nfields)
+    {
+        for(uint32_t f = 0; f < soa->nfields; f++)
+            cvec_free(soa->columns[f]);
+
+        cvec_free(soa->columns);
+        soa->columns = NULL;
+        soa->nfields = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+// Returns the number of records
+static inline
+uint64_t cvec_soa_get_sz(const cvec_soa* soa)
+{
+    return (soa && soa->columns) ? cvec_get_sz(soa->columns[0]) : 0;
+}
+
+// Returns the column vector of a field, NULL if out of bounds.
+// Like any vector it may move when the container grows.
+static inline
+void* cvec_soa_column(const cvec_soa* soa, uint32_t field)
+{
+    if(!soa || !soa->columns || field >= soa->nfields)
+        return (NULL);
+
+    return soa->columns[field];
+}
+
+// Brings every column to the same capacity of at least min_capacity,
+// picked by the growth policy of the first column. Returns 0 on failure.
+static inline
+int32_t internal_cvec_soa_grow_(cvec_soa* soa, uint64_t min_capacity, int32_t exact)
+{
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(soa->columns[0]);
+
+    if(min_capacity <= meta__->capacity)
+        return 1;
+
+    uint64_t target = exact ? min_capacity : internal_cvec_next_capacity_(meta__, min_capacity);
+
+    // A failure leaves some columns larger, never shorter, than the others
+    for(uint32_t f = 0; f < soa->nfields; f++)
+    {
+        if(cvec_get_capacity(soa->columns[f]) >= target)
+            continue;
+
+        void* column = internal_cvec_set_capacity_(soa->columns[f], target);
+        if(!column)
+            return 0;
+
+        soa->columns[f] = column;
+    }
+
+    return 1;
+}
+
+// Makes room for capacity records in every column, returns 0 on failure
+static inline
+int32_t cvec_soa_reserve(cvec_soa* soa, size_t capacity)
+{
+    if(!soa || !soa->columns) return 0;
+
+    return internal_cvec_soa_grow_(soa, capacity, 1);
+}
+
+// Appends a record, scattering its fields to the columns.
+// Returns 0 on failure, leaving the container unchanged.
+static inline
+int32_t cvec_soa_push_back(cvec_soa* soa, const void* record)
+{
+    if(!soa || !soa->columns || !record) return 0;
+
+    uint64_t sz = cvec_soa_get_sz(soa);
+
+    if(!internal_cvec_soa_grow_(soa, sz + 1, 0))
+        return 0;
+
+    for(uint32_t f = 0; f < soa->nfields; f++)
+    {
+        internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(soa->columns[f]);
+
+        memcpy((uint8_t*)soa->columns[f] + sz * meta__->typesize,
+               (const uint8_t*)record + soa->fields[f].offset, meta__->typesize);
+        meta__->size++;
+    }
+
+    return 1;
+}
+
+// Gathers the record at index into record, returns 0 if out of bounds
+static inline
+int32_t cvec_soa_get(const cvec_soa* soa, uint64_t index, void* record)
+{
+    if(!record || index >= cvec_soa_get_sz(soa)) return 0;
+
+    for(uint32_t f = 0; f < soa->nfields; f++)
+        memcpy((uint8_t*)record + soa->fields[f].offset,
+               (const uint8_t*)soa->columns[f] + index * soa->fields[f].size, soa->fields[f].size);
+
+    return 1;
+}
+
+// Erases the record at index from every column
+static inline
+void cvec_soa_erase(cvec_soa* soa, size_t index)
+{
+    if(!soa || !soa->columns) return ;
+
+    for(uint32_t f = 0; f < soa->nfields; f++)
+        cvec_erase(soa->columns[f], index);
+}
+
+// Removes every record, keeping the capacity
+static inline
+void cvec_soa_clear(cvec_soa* soa)
+{
+    if(!soa || !soa->columns) return ;
+
+    for(uint32_t f = 0; f < soa->nfields; f++)
+        cvec_clear(soa->columns[f]);
+}
+
+// Frees every column
+static inline
+void cvec_soa_free(cvec_soa* soa)
+{
+    if(!soa || !soa->columns) return ;
+
+    for(uint32_t f = 0; f < soa->nfields; f++)
+        cvec_free(soa->columns[f]);
+
+    cvec_free(soa->columns);
+
+    soa->columns = NULL;
+    soa->nfields = 0;
+}
+
+
+// Packed bit vectors.
+// A cvec_bits stores one bit per entry in a cvec of 64 bit words, so it
+// shares the header and growth policy of a regular vector. Bits past the
+// size are kept at zero, which lets popcount, find and the bulk operations
+// work a whole word at a time.
+
+typedef struct
+{
+    uint64_t* words;     // cvec of words, bit i lives in words[i / 64]
+    uint64_t  size;      // number of bits
+} cvec_bits;
+
+
+static inline
+uint32_t internal_cvec_ctz64_(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctzll(mask);
+#else
+    uint32_t i = 0;
+    while(!(mask & 1u)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+static inline
+uint64_t internal_cvec_popcount64_(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint64_t)__builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (x * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+// Clears the bits of the last word past the size
+static inline
+void internal_cvec_bits_trim_(cvec_bits* bits)
+{
+    uint64_t tail = bits->size & 63;
+
+    if(tail)
+        bits->words[bits->size >> 6] &= ((uint64_t)1 << tail) - 1;
+}
+
+
+// Initializes an empty bit vector with room for capacity bits, returns 0 on failure
+static inline
+int32_t cvec_bits_init(cvec_bits* bits, size_t capacity)
+{
+    if(!bits) return 0;
+
+    bits->size  = 0;
+    bits->words = (uint64_t*)cvec_reserve(capacity ? (capacity + 63) / 64 : 1, sizeof(uint64_t), NULL);
+
+    return bits->words != NULL;
+}
+
+// Returns the number of bits
+static inline
+uint64_t cvec_bits_get_sz(const cvec_bits* bits)
+{
+    return bits ? bits->size : 0;
+}
+
+// Resizes to size bits, new bits are set to value. Returns 0 on failure.
+static inline
+int32_t cvec_bits_resize(cvec_bits* bits, size_t size, int32_t value)
+{
+    if(!bits || !bits->words) return 0;
+
+    uint64_t old_size = bits->size;
+    uint64_t fill     = value ? UINT64_MAX : 0;
+
+    uint64_t* words = (uint64_t*)cvec_resize(bits->words, (size + 63) / 64, &fill);
+    if(!words)
+        return 0;
+
+    bits->words = words;
+    bits->size  = size;
+
+    // The old last word only holds zeros past the old size
+    if(value && size > old_size && (old_size & 63))
+        bits->words[old_size >> 6] |= ~(((uint64_t)1 << (old_size & 63)) - 1);
+
+    internal_cvec_bits_trim_(bits);
+
+    return 1;
+}
+
+// Appends one bit, returns 0 on failure
+static inline
+int32_t cvec_bits_push_back(cvec_bits* bits, int32_t value)
+{
+    if(!bits || !bits->words) return 0;
+
+    if((bits->size & 63) == 0)
+    {
+        uint64_t  zero  = 0;
+        uint64_t* words = (uint64_t*)cvec_push_back(bits->words, &zero);
+        if(!words)
+            return 0;
+
+        bits->words = words;
+    }
+
+    if(value)
+        bits->words[bits->size >> 6] |= (uint64_t)1 << (bits->size & 63);
+
+    bits->size++;
+
+    return 1;
+}
+
+// Sets the bit at index, out of bounds indices are ignored
+static inline
+void cvec_bits_set(cvec_bits* bits, uint64_t index)
+{
+    if(!bits || index >= bits->size) return ;
+
+    bits->words[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+// Clears the bit at index, out of bounds indices are ignored
+static inline
+void cvec_bits_clear(cvec_bits* bits, uint64_t index)
+{
+    if(!bits || index >= bits->size) return ;
+
+    bits->words[index >> 6] &= ~((uint64_t)1 << (index & 63));
+}
+
+// Returns the bit at index, 0 if out of bounds
+static inline
+int32_t cvec_bits_test(const cvec_bits* bits, uint64_t index)
+{
+    if(!bits || index >= bits->size) return 0;
+
+    return (int32_t)((bits->words[index >> 6] >> (index & 63)) & 1u);
+}
+
+// Sets every bit to value
+static inline
+void cvec_bits_fill(cvec_bits* bits, int32_t value)
+{
+    if(!bits || !bits->words) return ;
+
+    memset(bits->words, value ? 0xff : 0, (size_t)cvec_get_sz(bits->words) * sizeof(uint64_t));
+    internal_cvec_bits_trim_(bits);
+}
+
+// Returns the number of set bits
+static inline
+uint64_t cvec_bits_popcount(const cvec_bits* bits)
+{
+    if(!bits || !bits->words) return 0;
+
+    uint64_t nwords = cvec_get_sz(bits->words);
+    uint64_t count  = 0;
+
+    for(uint64_t w = 0; w < nwords; w++)
+        count += internal_cvec_popcount64_(bits->words[w]);
+
+    return count;
+}
+
+// Returns the index of the first set bit at or after from, CVEC_NPOS if none
+static inline
+uint64_t cvec_bits_find_first_set(const cvec_bits* bits, uint64_t from)
+{
+    if(!bits || !bits->words || from >= bits->size) return CVEC_NPOS;
+
+    uint64_t nwords = cvec_get_sz(bits->words);
+    uint64_t w      = from >> 6;
+
+    // Mask off the bits below from in the first word
+    uint64_t word = bits->words[w] & (UINT64_MAX << (from & 63));
+
+    for(;;)
+    {
+        if(word)
+            return (w << 6) + internal_cvec_ctz64_(word);
+
+        if(++w == nwords)
+            return CVEC_NPOS;
+
+        word = bits->words[w];
+    }
+}
+
+// Bulk dst &= src, src counts as zero past its end
+static inline
+void cvec_bits_and(cvec_bits* dst, const cvec_bits* src)
+{
+    if(!dst || !dst->words || !src || !src->words) return ;
+
+    uint64_t nwords = cvec_get_sz(dst->words);
+    uint64_t common = cvec_get_sz(src->words);
+    if(common > nwords)
+        common = nwords;
+
+    for(uint64_t w = 0; w < common; w++)
+        dst->words[w] &= src->words[w];
+
+    memset(dst->words + common, 0, (size_t)(nwords - common) * sizeof(uint64_t));
+}
+
+// Bulk dst |= src over the bits both vectors have
+static inline
+void cvec_bits_or(cvec_bits* dst, const cvec_bits* src)
+{
+    if(!dst || !dst->words || !src || !src->words) return ;
+
+    uint64_t common = cvec_get_sz(src->words);
+    if(common > cvec_get_sz(dst->words))
+        common = cvec_get_sz(dst->words);
+
+    for(uint64_t w = 0; w < common; w++)
+        dst->words[w] |= src->words[w];
+
+    internal_cvec_bits_trim_(dst);
+}
+
+// Bulk dst ^= src over the bits both vectors have
+static inline
+void cvec_bits_xor(cvec_bits* dst, const cvec_bits* src)
+{
+    if(!dst || !dst->words || !src || !src->words) return ;
+
+    uint64_t common = cvec_get_sz(src->words);
+    if(common > cvec_get_sz(dst->words))
+        common = cvec_get_sz(dst->words);
+
+    for(uint64_t w = 0; w < common; w++)
+        dst->words[w] ^= src->words[w];
+
+    internal_cvec_bits_trim_(dst);
+}
+
+// Frees the words
+static inline
+void cvec_bits_free(cvec_bits* bits)
+{
+    if(!bits) return ;
+
+    cvec_free(bits->words);
+
+    bits->words = NULL;
+    bits->size  = 0;
+}
+
+
+// Bump arena for request scoped vectors.
+// Vectors created with cvec_arena_allocator() bump allocate their storage,
+// the most recent allocation grows in place and cvec_arena_reset() releases
+// every vector at once. Destructors are NOT run on reset, call cvec_free
+// first for vectors that own resources.
+
+#define INTERNAL_CVEC_ARENA_ALIGN 16
+
+typedef struct internal_cvec_arena_block_
+{
+    struct internal_cvec_arena_block_* next;
+
+    uint64_t capacity;
+    uint64_t used;
+} internal_cvec_arena_block_;
+
+typedef struct
+{
+    cvec_allocator allocator;
+
+    internal_cvec_arena_block_* blocks;   // current block first
+    uint64_t                    block_sz;
+    uint8_t*                    last;     // most recent allocation
+} cvec_arena;
+
+
+static inline
+uint8_t* internal_cvec_arena_block_data_(internal_cvec_arena_block_* block)
+{
+    return (uint8_t*)block + internal_cvec_align_up_(sizeof(internal_cvec_arena_block_),
+                                                     INTERNAL_CVEC_ARENA_ALIGN);
+}
+
+static inline
+void* internal_cvec_arena_alloc_(void* ctx, size_t sz)
+{
+    cvec_arena* arena = (cvec_arena*)ctx;
+    internal_cvec_arena_block_* block = arena->blocks;
+
+    sz = internal_cvec_align_up_(sz, INTERNAL_CVEC_ARENA_ALIGN);
+
+    if(!block || block->capacity - block->used < sz)
+    {
+        uint64_t capacity = (sz > arena->block_sz) ? sz : arena->block_sz;
+
+        block = (internal_cvec_arena_block_*)
+                INTERNAL_CVEC_MALLOC(internal_cvec_align_up_(sizeof(internal_cvec_arena_block_),
+                                                             INTERNAL_CVEC_ARENA_ALIGN) + capacity);
+        if(!block)
+            return (NULL);
+
+        block->next     = arena->blocks;
+        block->capacity = capacity;
+        block->used     = 0;
+        arena->blocks   = block;
+    }
+
+    uint8_t* ptr = internal_cvec_arena_block_data_(block) + block->used;
+    block->used += sz;
+    arena->last  = ptr;
+
+    return ptr;
+}
+
+static inline
+void* internal_cvec_arena_realloc_(void* ctx, void* ptr, size_t old_sz, size_t new_sz)
+{
+    cvec_arena* arena = (cvec_arena*)ctx;
+    internal_cvec_arena_block_* block = arena->blocks;
+
+    if(!ptr)
+        return internal_cvec_arena_alloc_(ctx, new_sz);
+
+    // The last allocation can be extended (or shrunk) in place
+    if((uint8_t*)ptr == arena->last)
+    {
+        uint64_t offset = (uint64_t)((uint8_t*)ptr - internal_cvec_arena_block_data_(block));
+        uint64_t sz     = internal_cvec_align_up_(new_sz, INTERNAL_CVEC_ARENA_ALIGN);
+
+        if(block->capacity - offset >= sz)
+        {
+            block->used = offset + sz;
+            return ptr;
+        }
+    }
+
+    void* new_ptr = internal_cvec_arena_alloc_(ctx, new_sz);
+    if(new_ptr)
+        memcpy(new_ptr, ptr, (old_sz < new_sz) ? old_sz : new_sz);
+
+    return new_ptr;
+}
+
+static inline
+void internal_cvec_arena_free_(void* ctx, void* ptr, size_t sz)
+{
+    cvec_arena* arena = (cvec_arena*)ctx;
+    (void)sz;
+
+    // Only the last allocation can be given back before a reset
+    if(ptr && (uint8_t*)ptr == arena->last)
+    {
+        arena->blocks->used = (uint64_t)((uint8_t*)ptr - internal_cvec_arena_block_data_(arena->blocks));
+        arena->last         = NULL;
+    }
+}
+
+
+// Initializes an arena that allocates blocks of block_sz bytes on demand
+static inline
+void cvec_arena_init(cvec_arena* arena, size_t block_sz)
+{
+    if(!arena) return ;
+
+    arena->allocator.ctx        = arena;
+    arena->allocator.alloc_fn   = internal_cvec_arena_alloc_;
+    arena->allocator.realloc_fn = internal_cvec_arena_realloc_;
+    arena->allocator.free_fn    = internal_cvec_arena_free_;
+
+    arena->blocks   = NULL;
+    arena->block_sz = block_sz ? block_sz : 4096;
+    arena->last     = NULL;
+}
+
+// Returns the allocator to put in cvec_options for vectors living in the arena
+static inline
+const cvec_allocator* cvec_arena_allocator(const cvec_arena* arena)
+{
+    return arena ? &arena->allocator : NULL;
+}
+
+// Releases every vector of the arena at once, keeping the current block for reuse
+static inline
+void cvec_arena_reset(cvec_arena* arena)
+{
+    if(!arena || !arena->blocks) return ;
+
+    internal_cvec_arena_block_* block = arena->blocks->next;
+    while(block)
+    {
+        internal_cvec_arena_block_* next = block->next;
+        INTERNAL_CVEC_FREE(block);
+        block = next;
+    }
+
+    arena->blocks->next = NULL;
+    arena->blocks->used = 0;
+    arena->last         = NULL;
+}
+
+// Releases every block owned by the arena
+static inline
+void cvec_arena_destroy(cvec_arena* arena)
+{
+    if(!arena) return ;
+
+    cvec_arena_reset(arena);
+
+    INTERNAL_CVEC_FREE(arena->blocks);
+    arena->blocks = NULL;
+}
+
+
+// Parallel bulk operations, compiled in only with CVEC_ENABLE_THREADS.
+// Work is split into chunks of about CVEC_PAR_CHUNK_BYTES whose starts sit on
+// 64 byte boundaries relative to the data pointer (cache aligned when the vector
+// uses alignment >= 64), so workers never share a cache line. Chunks are handed
+// to an executor; cvec_par_pool is a small pthread pool where workers claim
+// chunks from a shared counter, callers can plug their own executor instead.
+// A NULL executor runs everything on the calling thread.
+#if defined(CVEC_ENABLE_THREADS)
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef CVEC_PAR_CHUNK_BYTES
+#define CVEC_PAR_CHUNK_BYTES (256 * 1024)
+#endif
+
+// chunk boundaries are kept on multiples of this many bytes from the data pointer
+#define INTERNAL_CVEC_PAR_LINE ((uint64_t)64)
+
+// typedef of a parallel task, runs chunk on arg
+typedef void (*cvec_par_task)(void* arg, uint64_t chunk);
+
+// typedef of a range transform, called on count contiguous elements
+typedef void (*cvec_par_range_fn)(void* first, uint64_t count, void* ctx);
+
+// run must call task(arg, i) once for every i in [0, nchunks) and return when all are done
+typedef struct
+{
+    void* ctx;
+    void (*run)(void* ctx, cvec_par_task task, void* arg, uint64_t nchunks);
+} cvec_par_executor;
+
+typedef struct
+{
+    cvec_par_executor executor;
+
+    pthread_t*      threads;
+    uint32_t        nthreads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_cond_t  done;
+
+    uint64_t        generation;
+    uint32_t        active;
+    int32_t         stop;
+
+    // current job
+    cvec_par_task   task;
+    void*           arg;
+    uint64_t        nchunks;
+    uint64_t        next;
+} cvec_par_pool;
+
+
+// Claims and runs chunks until none are left
+static inline
+void internal_cvec_par_drain_(cvec_par_pool* pool)
+{
+    uint64_t chunk;
+
+    while((chunk = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->nchunks)
+        pool->task(pool->arg, chunk);
+}
+
+static inline
+void* internal_cvec_par_worker_(void* arg)
+{
+    cvec_par_pool* pool = (cvec_par_pool*)arg;
+    uint64_t       seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for(;;)
+    {
+        while(!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+
+        if(pool->stop)
+            break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        internal_cvec_par_drain_(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->active == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static inline
+void internal_cvec_par_pool_run_(void* ctx, cvec_par_task task, void* arg, uint64_t nchunks)
+{
+    cvec_par_pool* pool = (cvec_par_pool*)ctx;
+
+    if(pool->nthreads == 0 || nchunks < 2)
+    {
+        for(uint64_t i = 0; i < nchunks; i++)
+            task(arg, i);
+        return ;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task    = task;
+    pool->arg     = arg;
+    pool->nchunks = nchunks;
+    pool->next    = 0;
+    pool->active  = pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    // The caller works too
+    internal_cvec_par_drain_(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->active)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+// Starts a pool with nthreads threads in total (0 for one per online CPU).
+// Returns 0 on failure. A pool must only be driven by one thread at a time.
+static inline
+int32_t cvec_par_pool_init(cvec_par_pool* pool, uint32_t nthreads)
+{
+    if(!pool) return 0;
+
+    memset(pool, 0, sizeof(*pool));
+
+    if(nthreads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads  = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+
+    pool->executor.ctx = pool;
+    pool->executor.run = internal_cvec_par_pool_run_;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // The calling thread is one of the workers
+    if(nthreads > 1)
+    {
+        pool->threads = (pthread_t*)INTERNAL_CVEC_MALLOC((nthreads - 1) * sizeof(pthread_t));
+        if(!pool->threads)
+            return 0;
+
+        for(uint32_t i = 0; i < nthreads - 1; i++)
+        {
+            if(pthread_create(&pool->threads[i], NULL, internal_cvec_par_worker_, pool) != 0)
+                break;
+            pool->nthreads++;
+        }
+    }
+
+    return 1;
+}
+
+// Returns the executor to hand to the cvec_par_* functions
+static inline
+const cvec_par_executor* cvec_par_pool_executor(const cvec_par_pool* pool)
+{
+    return pool ? &pool->executor : NULL;
+}
+
+// Stops and joins every worker
+static inline
+void cvec_par_pool_destroy(cvec_par_pool* pool)
+{
+    if(!pool) return ;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(uint32_t i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    INTERNAL_CVEC_FREE(pool->threads);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+
+    pool->threads  = NULL;
+    pool->nthreads = 0;
+}
+
+
+typedef struct
+{
+    uint8_t*          dst;
+    const uint8_t*    src;
+    uint64_t          count;
+    uint64_t          elem_sz;
+    uint64_t          chunk_elems;
+    cvec_par_range_fn fn;
+    void*             ctx;
+    cvec_compare_fn   cmp;
+    uint64_t          width;
+} internal_cvec_par_job_;
+
+static inline
+void internal_cvec_par_run_(const cvec_par_executor* executor, cvec_par_task task,
+                            internal_cvec_par_job_* job, uint64_t nchunks)
+{
+    if(executor && executor->run)
+    {
+        executor->run(executor->ctx, task, job, nchunks);
+        return ;
+    }
+
+    for(uint64_t i = 0; i < nchunks; i++)
+        task(job, i);
+}
+
+// Splits count elements into chunks of about CVEC_PAR_CHUNK_BYTES, returns the chunk count.
+// The chunk length is rounded up so chunk_elems * elem_sz is a multiple of INTERNAL_CVEC_PAR_LINE.
+static inline
+uint64_t internal_cvec_par_chunks_(internal_cvec_par_job_* job, uint64_t count, uint64_t elem_sz)
+{
+    uint64_t sz          = elem_sz ? elem_sz : 1;
+    uint64_t chunk_elems = CVEC_PAR_CHUNK_BYTES / sz;
+    if(!chunk_elems) chunk_elems = 1;
+
+    // smallest element count covering a whole number of lines: line / gcd(sz, line)
+    uint64_t low  = sz & (~sz + 1);
+    uint64_t step = (low < INTERNAL_CVEC_PAR_LINE) ? INTERNAL_CVEC_PAR_LINE / low : 1;
+
+    chunk_elems = ((chunk_elems + step - 1) / step) * step;
+
+    job->count       = count;
+    job->elem_sz     = elem_sz;
+    job->chunk_elems = chunk_elems;
+
+    return (count + job->chunk_elems - 1) / job->chunk_elems;
+}
+
+// Returns the bounds of chunk in [first, first + n)
+static inline
+uint64_t internal_cvec_par_span_(const internal_cvec_par_job_* job, uint64_t chunk, uint64_t* first)
+{
+    *first = chunk * job->chunk_elems;
+
+    uint64_t left = job->count - *first;
+    return (left < job->chunk_elems) ? left : job->chunk_elems;
+}
+
+static inline
+void internal_cvec_par_fill_task_(void* arg, uint64_t chunk)
+{
+    internal_cvec_par_job_* job = (internal_cvec_par_job_*)arg;
+
+    uint64_t first;
+    uint64_t n = internal_cvec_par_span_(job, chunk, &first);
+
+    uint8_t* out = job->dst + first * job->elem_sz;
+    for(uint64_t i = 0; i < n; i++)
+        memcpy(out + i * job->elem_sz, job->src, job->elem_sz);
+}
+
+static inline
+void internal_cvec_par_copy_task_(void* arg, uint64_t chunk)
+{
+    internal_cvec_par_job_* job = (internal_cvec_par_job_*)arg;
+
+    uint64_t first;
+    uint64_t n = internal_cvec_par_span_(job, chunk, &first);
+
+    memcpy(job->dst + first * job->elem_sz, job->src + first * job->elem_sz, n * job->elem_sz);
+}
+
+static inline
+void internal_cvec_par_transform_task_(void* arg, uint64_t chunk)
+{
+    internal_cvec_par_job_* job = (internal_cvec_par_job_*)arg;
+
+    uint64_t first;
+    uint64_t n = internal_cvec_par_span_(job, chunk, &first);
+
+    job->fn(job->dst + first * job->elem_sz, n, job->ctx);
+}
+
+
+// Set every element of the vector to a copy of elem
+static inline
+void cvec_par_fill(void* vec, const void* elem, const cvec_par_executor* executor)
+{
+    if(!vec || !elem) return ;
+
+    internal_cvec_par_job_ job;
+    memset(&job, 0, sizeof(job));
+
+    uint64_t nchunks = internal_cvec_par_chunks_(&job, cvec_get_sz(vec), cvec_get_type_sz(vec));
+
+    job.dst = (uint8_t*)vec;
+    job.src = (const uint8_t*)elem;
+
+    internal_cvec_par_run_(executor, internal_cvec_par_fill_task_, &job, nchunks);
+}
+
+// Call fn on every chunk of the vector, in place
+static inline
+void cvec_par_transform(void* vec, cvec_par_range_fn fn, void* ctx, const cvec_par_executor* executor)
+{
+    if(!vec || !fn) return ;
+
+    internal_cvec_par_job_ job;
+    memset(&job, 0, sizeof(job));
+
+    uint64_t nchunks = internal_cvec_par_chunks_(&job, cvec_get_sz(vec), cvec_get_type_sz(vec));
+
+    job.dst = (uint8_t*)vec;
+    job.fn  = fn;
+    job.ctx = ctx;
+
+    internal_cvec_par_run_(executor, internal_cvec_par_transform_task_, &job, nchunks);
+}
+
+// Replace the contents of dst with a copy of src (same type size), growing dst once.
+// Returns the (possibly moved) dst, or NULL on failure like cvec_push_back.
+static inline
+void* cvec_par_copy(void* dst, const void* src, const cvec_par_executor* executor)
+{
+    if(!dst || !src)
+        return dst;
+
+    if(cvec_get_type_sz(dst) != cvec_get_type_sz(src))
+        return dst;
+
+    uint64_t sz = cvec_get_sz(src);
+
+    cvec_clear(dst);
+
+    dst = cvec_grow(dst, sz);
+    if(!dst)
+        return (NULL);
+
+    internal_cvec_par_job_ job;
+    memset(&job, 0, sizeof(job));
+
+    uint64_t nchunks = internal_cvec_par_chunks_(&job, sz, cvec_get_type_sz(src));
+
+    job.dst = (uint8_t*)dst;
+    job.src = (const uint8_t*)src;
+
+    internal_cvec_par_run_(executor, internal_cvec_par_copy_task_, &job, nchunks);
+
+    INTERNAL_CVEC_GET_METADATA(dst)->size = sz;
+
+    return dst;
+}
+
+
+static inline
+void internal_cvec_par_sort_task_(void* arg, uint64_t chunk)
+{
+    internal_cvec_par_job_* job = (internal_cvec_par_job_*)arg;
+
+    uint64_t first;
+    uint64_t n = internal_cvec_par_span_(job, chunk, &first);
+
+    qsort(job->dst + first * job->elem_sz, n, job->elem_sz, job->cmp);
+}
+
+// Merges runs 2*pair and 2*pair + 1 of job->width elements from src into dst
+static inline
+void internal_cvec_par_merge_task_(void* arg, uint64_t pair)
+{
+    internal_cvec_par_job_* job = (internal_cvec_par_job_*)arg;
+
+    uint64_t elem_sz = job->elem_sz;
+    uint64_t lo      = 2 * pair * job->width;
+    uint64_t mid     = (lo + job->width < job->count) ? lo + job->width : job->count;
+    uint64_t hi      = (mid + job->width < job->count) ? mid + job->width : job->count;
+
+    const uint8_t* src = job->src;
+    uint8_t*       out = job->dst + lo * elem_sz;
+
+    uint64_t i = lo, j = mid;
+
+    while(i < mid && j < hi)
+    {
+        // Take from the left run on ties to stay stable between runs
+        if(job->cmp(src + j * elem_sz, src + i * elem_sz) < 0)
+            memcpy(out, src + (j++) * elem_sz, elem_sz);
+        else
+            memcpy(out, src + (i++) * elem_sz, elem_sz);
+        out += elem_sz;
+    }
+
+    memcpy(out, src + i * elem_sz, (mid - i) * elem_sz);
+    out += (mid - i) * elem_sz;
+    memcpy(out, src + j * elem_sz, (hi - j) * elem_sz);
+}
+
+// Sort the vector: chunks are sorted in parallel, then merged pairwise in
+// parallel passes. Needs a scratch copy of the data from the vector's
+// allocator, returns 0 and leaves the vector untouched if that fails.
+static inline
+int32_t cvec_par_sort(void* vec, cvec_compare_fn cmp, const cvec_par_executor* executor)
+{
+    if(!vec || !cmp) return 1;
+
+    internal_cvec_metadata_* meta__ = INTERNAL_CVEC_GET_METADATA(vec);
+
+    internal_cvec_par_job_ job;
+    memset(&job, 0, sizeof(job));
+
+    uint64_t nchunks = internal_cvec_par_chunks_(&job, meta__->size, meta__->typesize);
+    uint64_t bytes   = meta__->size * meta__->typesize;
+
+    if(nchunks < 2)
+    {
+        cvec_sort(vec, cmp);
+        return 1;
+    }
+
+    uint8_t* scratch = (uint8_t*)internal_cvec_mem_alloc_(meta__->allocator, bytes, 0);
+    if(!scratch)
+        return 0;
+
+    job.dst = (uint8_t*)vec;
+    job.cmp = cmp;
+
+    internal_cvec_par_run_(executor, internal_cvec_par_sort_task_, &job, nchunks);
+
+    uint8_t* src = (uint8_t*)vec;
+    uint8_t* dst = scratch;
+
+    for(job.width = job.chunk_elems; job.width < job.count; job.width *= 2)
+    {
+        uint64_t runs = (job.count + job.width - 1) / job.width;
+
+        job.src = src;
+        job.dst = dst;
+
+        internal_cvec_par_run_(executor, internal_cvec_par_merge_task_, &job, (runs + 1) / 2);
+
+        uint8_t* swap = src; src = dst; dst = swap;
+    }
+
+    if(src != (uint8_t*)vec)
+        memcpy(vec, src, bytes);
+
+    internal_cvec_mem_free_(meta__->allocator, scratch, bytes);
+
+    return 1;
+}
+
+#endif // CVEC_ENABLE_THREADS
+
+
+// Concurrent append vectors, compiled in only with CVEC_ENABLE_THREADS.
+// Producers claim slots with a fetch-add on the size and never block each
+// other. Storage is a fixed directory of segments whose sizes double
+// (CVEC_CONC_FIRST_SEGMENT << k elements), so growth allocates a new
+// segment and elements never move while readers hold pointers to them.
+// A slot may be read once the push that claimed it has returned.
+// A segment whose allocation fails is marked failed for good: every slot in
+// it stays claimed but unwritten, cvec_conc_at returns NULL for them and
+// cvec_conc_free does not destroy them.
+#if defined(CVEC_ENABLE_THREADS)
+
+#ifndef CVEC_CONC_FIRST_SEGMENT
+#define CVEC_CONC_FIRST_SEGMENT 64
+#endif
+
+#define INTERNAL_CVEC_CONC_SEGMENTS 48
+
+// Marks a segment whose allocation failed, never dereferenced
+#define INTERNAL_CVEC_CONC_FAILED ((uint8_t*)(uintptr_t)1)
+
+typedef struct
+{
+    uint64_t             size;       // claimed slots, atomic
+    uint64_t             typesize;
+    cvec_elem_destructor destructor;
+
+    uint8_t*             segments[INTERNAL_CVEC_CONC_SEGMENTS];
+} cvec_conc;
+
+
+// Returns the segment holding index and the index inside it
+static inline
+uint32_t internal_cvec_conc_locate_(uint64_t index, uint64_t* offset)
+{
+    // Segment k holds CVEC_CONC_FIRST_SEGMENT << k elements starting at
+    // CVEC_CONC_FIRST_SEGMENT * ((1 << k) - 1)
+    uint64_t scaled  = index / CVEC_CONC_FIRST_SEGMENT + 1;
+    uint32_t segment = 63u - (uint32_t)__builtin_clzll(scaled);
+
+    *offset = index - CVEC_CONC_FIRST_SEGMENT * (((uint64_t)1 << segment) - 1);
+
+    return segment;
+}
+
+// Returns segment k, allocating it if needed (losers of the race free their copy).
+// A failed allocation publishes INTERNAL_CVEC_CONC_FAILED unless another
+// thread installed the segment first, so every claimant of the segment agrees.
+static inline
+uint8_t* internal_cvec_conc_segment_(cvec_conc* vec, uint32_t segment)
+{
+    uint8_t* data = __atomic_load_n(&vec->segments[segment], __ATOMIC_ACQUIRE);
+    if(data)
+        return (data == INTERNAL_CVEC_CONC_FAILED) ? NULL : data;
+
+    uint64_t bytes = ((uint64_t)CVEC_CONC_FIRST_SEGMENT << segment) * vec->typesize;
+
+    uint8_t* fresh = (uint8_t*)INTERNAL_CVEC_CALLOC(1, bytes);
+    uint8_t* mine  = fresh ? fresh : INTERNAL_CVEC_CONC_FAILED;
+
+    if(__atomic_compare_exchange_n(&vec->segments[segment], &data, mine, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return fresh;
+
+    if(fresh)
+        INTERNAL_CVEC_FREE(fresh);
+
+    return (data == INTERNAL_CVEC_CONC_FAILED) ? NULL : data;
+}
+
+
+// Initializes an empty concurrent vector
+static inline
+void cvec_conc_init(cvec_conc* vec, size_t elem_sz, cvec_elem_destructor destructor)
+{
+    if(!vec) return ;
+
+    memset(vec, 0, sizeof(*vec));
+
+    vec->typesize   = elem_sz;
+    vec->destructor = destructor;
+}
+
+// Returns the number of claimed slots, including the ones of failed pushes
+static inline
+uint64_t cvec_conc_get_sz(const cvec_conc* vec)
+{
+    return vec ? __atomic_load_n(&vec->size, __ATOMIC_ACQUIRE) : 0;
+}
+
+// Returns a pointer to the element at index, stable for the vector's lifetime.
+// NULL when the push that claimed index failed.
+static inline
+void* cvec_conc_at(cvec_conc* vec, uint64_t index)
+{
+    if(!vec || index >= cvec_conc_get_sz(vec))
+        return (NULL);
+
+    uint64_t offset;
+    uint32_t segment = internal_cvec_conc_locate_(index, &offset);
+
+    uint8_t* data = __atomic_load_n(&vec->segments[segment], __ATOMIC_ACQUIRE);
+
+    return (data && data != INTERNAL_CVEC_CONC_FAILED) ? data + offset * vec->typesize : NULL;
+}
+
+// Claims a slot, copies elem into it and returns its index (CVEC_NPOS on failure).
+// Safe to call from any number of threads at once.
+static inline
+uint64_t cvec_conc_push_back(cvec_conc* vec, const void* elem)
+{
+    if(!vec || !elem)
+        return CVEC_NPOS;
+
+    uint64_t index = __atomic_fetch_add(&vec->size, 1, __ATOMIC_ACQ_REL);
+
+    uint64_t offset;
+    uint32_t segment = internal_cvec_conc_locate_(index, &offset);
+
+    uint8_t* data = (segment < INTERNAL_CVEC_CONC_SEGMENTS) ? internal_cvec_conc_segment_(vec, segment) : NULL;
+    if(!data)
+        return CVEC_NPOS;
+
+    memcpy(data + offset * vec->typesize, elem, vec->typesize);
+
+    return index;
 }
 
+// Destroys every element and frees the segments, no producer may be running
+static inline
+void cvec_conc_free(cvec_conc* vec)
+{
+    if(!vec) return ;
+
+    uint64_t sz = vec->size;
+
+    for(uint32_t k = 0; k < INTERNAL_CVEC_CONC_SEGMENTS; k++)
+    {
+        uint8_t* data = vec->segments[k];
+        vec->segments[k] = NULL;
+
+        // Failed claims were never written, there is nothing to destroy
+        if(!data || data == INTERNAL_CVEC_CONC_FAILED)
+            continue;
+
+        uint64_t first = CVEC_CONC_FIRST_SEGMENT * (((uint64_t)1 << k) - 1);
+        uint64_t count = (uint64_t)CVEC_CONC_FIRST_SEGMENT << k;
+
+        if(vec->destructor && first < sz)
+        {
+            uint64_t live = (sz - first < count) ? sz - first : count;
+
+            for(uint64_t i = 0; i < live; i++)
+                vec->destructor(data + i * vec->typesize);
+        }
+
+        INTERNAL_CVEC_FREE(data);
+    }
+
+    vec->size = 0;
+}
+
+#endif // CVEC_ENABLE_THREADS
+
 
 // undef internal cvec stuff
 #undef INTERNAL_CVEC_FREE
@@ -224,6 +5332,37 @@ void cvec_free(void* vec)
 #undef INTERNAL_CVEC_REALLOC
 
 #undef INTERNAL_CVEC_GET_METADATA
+#undef INTERNAL_CVEC_GET_COMPACT_METADATA
+#undef INTERNAL_CVEC_DEFINE_FIND_INT_
+#undef INTERNAL_CVEC_DEFINE_FIND_FLOAT_
+#undef INTERNAL_CVEC_DEFINE_REDUCE_
+#undef INTERNAL_CVEC_DEFINE_EXTREMUM_
+#undef INTERNAL_CVEC_DEFINE_EXTREMUM_SCALAR_
+#undef INTERNAL_CVEC_NEON_PICK_
+#undef INTERNAL_CVEC_LOAD256_
+#undef INTERNAL_CVEC_STORE256_
+#undef INTERNAL_CVEC_LOAD128_
+#undef INTERNAL_CVEC_STORE128_
+#undef INTERNAL_CVEC_SET1_32x8_
+#undef INTERNAL_CVEC_SET1_64x4_
+#undef INTERNAL_CVEC_SET1_32x4_
+#undef INTERNAL_CVEC_LT_
+#undef INTERNAL_CVEC_GT_
+#undef INTERNAL_CVEC_DEFINE_RADIX_
+#undef INTERNAL_CVEC_DEFINE_LOWER_BOUND_
+#undef INTERNAL_CVEC_KEY_SELF_
+#undef INTERNAL_CVEC_KEY_PAIR_
+#undef INTERNAL_CVEC_RADIX_MIN
+#undef INTERNAL_CVEC_ARENA_ALIGN
+#undef INTERNAL_CVEC_CONC_SEGMENTS
+#undef INTERNAL_CVEC_CONC_FAILED
+#undef INTERNAL_CVEC_MAP_ANON
+#undef INTERNAL_CVEC_MREMAP
+#undef INTERNAL_CVEC_MMAP_GROWTH
+#undef INTERNAL_CVEC_FD_CHUNK
+#undef INTERNAL_CVEC_PAR_LINE
+#undef INTERNAL_CVEC_DEFINE_DELTA_
+#undef INTERNAL_CVEC_DEFINE_DELTA_FD_
 
 #endif //CVEC_H_
 
@@ -0,0 +1,678 @@
+// cvec tests: boundary sizes, stream and file headers, mmap backed growth,
+// deque rings, delta encoding and concurrent appends. Build and run from the
+// repository root:
+//
+//   make test
+//
+// A failed check prints its location, the exit status is the failure count.
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+// Low enough that the tests cross into mmap backing
+#if !defined(CVEC_MMAP_THRESHOLD)
+#define CVEC_MMAP_THRESHOLD 65536
+#endif
+#define CVEC_ENABLE_MAP_FILE
+#include "cvec.h"
+
+#if defined(CVEC_ENABLE_THREADS)
+#include <pthread.h>
+#endif
+
+static int test_failures;
+
+#define TEST_CHECK(cond)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if(!(cond))                                                             \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while(0)
+
+
+// Reserve and growth requests whose block size cannot fit a size_t
+static void test_size_limits(void)
+{
+    TEST_CHECK(cvec_reserve(SIZE_MAX, 1, NULL) == NULL);
+    TEST_CHECK(cvec_reserve(SIZE_MAX / 8, 8, NULL) == NULL);
+    TEST_CHECK(cvec_reserve(SIZE_MAX - 64, 1, NULL) == NULL);
+    TEST_CHECK(cvec_reserve_aligned(SIZE_MAX / 64, 64, 64, NULL) == NULL);
+
+    int32_t* vec = (int32_t*)cvec_create(sizeof(int32_t), NULL);
+    for(int32_t i = 0; i < 10; i++)
+        vec = (int32_t*)cvec_push_back(vec, &i);
+
+    uint64_t capacity = cvec_get_capacity(vec);
+
+    // Every failure leaves the vector untouched
+    TEST_CHECK(cvec_grow(vec, SIZE_MAX) == NULL);
+    TEST_CHECK(cvec_grow(vec, SIZE_MAX - 9) == NULL);
+    TEST_CHECK(cvec_grow(vec, SIZE_MAX / 4) == NULL);
+    TEST_CHECK(cvec_resize(vec, SIZE_MAX, NULL) == NULL);
+    TEST_CHECK(cvec_push_back_n(vec, vec, SIZE_MAX) == NULL);
+    TEST_CHECK(cvec_insert_n(vec, 0, vec, SIZE_MAX) == NULL);
+    TEST_CHECK(cvec_emplace_back_n(&vec, SIZE_MAX) == NULL);
+
+    TEST_CHECK(cvec_get_sz(vec) == 10 && cvec_get_capacity(vec) == capacity);
+
+    int32_t next = 10;
+    vec = (int32_t*)cvec_push_back(vec, &next);
+    TEST_CHECK(vec && vec[9] == 9 && vec[10] == 10);
+
+    // A policy step past the limit is clamped, the request itself still fits
+    vec = (int32_t*)cvec_grow(vec, 1000);
+    TEST_CHECK(vec && cvec_get_capacity(vec) >= 1011);
+
+    cvec_free(vec);
+}
+
+
+#if defined(CVEC_HAS_MMAP)
+// Returns whether every byte of the capacity past the size reads as zero
+static int test_tail_zero(const uint8_t* vec, uint64_t elem_sz)
+{
+    for(uint64_t i = cvec_get_sz(vec) * elem_sz; i < cvec_get_capacity(vec) * elem_sz; i++)
+        if(vec[i])
+            return 0;
+    return 1;
+}
+
+// Aligned vectors growing from the heap into a mapping, then moving within it
+static void test_mmap_growth(void)
+{
+    static const uint32_t alignments[] = { 0, 16, 64, 256, 4096 };
+
+    for(size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++)
+    {
+        uint32_t align = alignments[a];
+
+        // Different heap offsets make the metadata offset change on the switch
+        for(size_t shift = 0; shift < 8; shift++)
+        {
+            void* junk = malloc(shift * 24 + 1);
+
+            cvec_options opts;
+            memset(&opts, 0, sizeof(opts));
+            opts.alignment = align;
+
+            uint64_t* vec = (uint64_t*)cvec_reserve_ex(4, sizeof(uint64_t), NULL, &opts);
+            TEST_CHECK(vec && !(internal_cvec_meta_(vec)->flags & CVEC_FLAG_MMAP));
+
+            uint64_t count = 200000;
+            for(uint64_t i = 0; i < count && vec; i++)
+                vec = (uint64_t*)cvec_push_back(vec, &i);
+
+            TEST_CHECK(vec && (internal_cvec_meta_(vec)->flags & CVEC_FLAG_MMAP));
+            TEST_CHECK(!align || (uintptr_t)vec % align == 0);
+
+            int32_t same = 1;
+            for(uint64_t i = 0; i < count; i++)
+                same = same && vec[i] == i;
+            TEST_CHECK(same);
+            TEST_CHECK(test_tail_zero((const uint8_t*)vec, sizeof(uint64_t)));
+
+            // Shrink inside the mapping and grow again, the new slots stay zero
+            cvec_erase_range(vec, 1000, count - 1000);
+            vec = (uint64_t*)cvec_shrink_to_fit(vec);
+            TEST_CHECK(cvec_get_sz(vec) == 1000 && vec[999] == 999);
+            TEST_CHECK(!align || (uintptr_t)vec % align == 0);
+
+            vec = (uint64_t*)cvec_grow(vec, 300000);
+            TEST_CHECK(vec && vec[999] == 999 && test_tail_zero((const uint8_t*)vec, sizeof(uint64_t)));
+            TEST_CHECK(!align || (uintptr_t)vec % align == 0);
+
+            cvec_free(vec);
+            free(junk);
+        }
+    }
+
+    // One heap block straight into a mapping, the metadata offset often slides down
+    for(uint32_t align = 16; align <= 256; align *= 2)
+    {
+        for(size_t shift = 0; shift < 40; shift++)
+        {
+            void* junk = malloc(shift * 8 + 1);
+
+            uint8_t* vec = (uint8_t*)cvec_reserve_aligned(100, 1, align, NULL);
+            uint8_t  x   = 0xab;
+            for(int i = 0; i < 100; i++)
+                vec = (uint8_t*)cvec_push_back(vec, &x);
+
+            vec = (uint8_t*)cvec_grow(vec, 200000);
+            TEST_CHECK(vec && (uintptr_t)vec % align == 0 && vec[99] == 0xab);
+            TEST_CHECK(test_tail_zero(vec, 1));
+
+            cvec_free(vec);
+            free(junk);
+        }
+    }
+
+    // Reserving past the threshold maps at once
+    uint8_t* big = (uint8_t*)cvec_reserve(CVEC_MMAP_THRESHOLD * 2, 1, NULL);
+    TEST_CHECK(big && (internal_cvec_meta_(big)->flags & CVEC_FLAG_MMAP) && test_tail_zero(big, 1));
+    cvec_free(big);
+}
+#endif
+
+
+// Returns an unlinked temporary file holding a stream header and len payload bytes
+static int test_stream_fd(uint64_t typesize, uint64_t size, const void* payload, size_t len)
+{
+    FILE* file = tmpfile();
+    if(!file)
+        return -1;
+
+    int fd = dup(fileno(file));
+    fclose(file);
+
+    cvec_stream_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CVEC_STREAM_MAGIC, sizeof(header.magic));
+    header.version  = CVEC_FILE_VERSION;
+    header.endian   = CVEC_FILE_ENDIAN;
+    header.typesize = typesize;
+    header.size     = size;
+
+    if(write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+       (len && write(fd, payload, len) != (ssize_t)len))
+    {
+        close(fd);
+        return -1;
+    }
+
+    lseek(fd, 0, SEEK_SET);
+
+    return fd;
+}
+
+
+// cvec_write_fd / cvec_read_fd with valid and crafted headers
+static void test_stream_headers(void)
+{
+    uint8_t payload[64];
+    for(size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = (uint8_t)i;
+
+    // A stream this short cannot hold size elements, whatever size claims
+    static const uint64_t sizes[] = { UINT64_MAX, UINT64_MAX / 2, (uint64_t)SIZE_MAX, (uint64_t)1 << 40, 65 };
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        int fd = test_stream_fd(1, sizes[i], payload, sizeof(payload));
+        TEST_CHECK(fd >= 0);
+        TEST_CHECK(cvec_read_fd(fd, 0, NULL) == NULL);
+        close(fd);
+    }
+
+    // Element sizes whose block cannot fit a size_t
+    int fd = test_stream_fd(UINT64_MAX, 1, payload, sizeof(payload));
+    TEST_CHECK(cvec_read_fd(fd, 0, NULL) == NULL);
+    close(fd);
+
+    fd = test_stream_fd((uint64_t)SIZE_MAX / 2, 4, payload, sizeof(payload));
+    TEST_CHECK(cvec_read_fd(fd, 0, NULL) == NULL);
+    close(fd);
+
+    // Type size mismatch and a zero type size
+    fd = test_stream_fd(4, 16, payload, sizeof(payload));
+    TEST_CHECK(cvec_read_fd(fd, 8, NULL) == NULL);
+    close(fd);
+
+    fd = test_stream_fd(0, 16, payload, sizeof(payload));
+    TEST_CHECK(cvec_read_fd(fd, 0, NULL) == NULL);
+    close(fd);
+
+    // The exact payload reads back
+    fd = test_stream_fd(4, 16, payload, sizeof(payload));
+    uint32_t* vec = (uint32_t*)cvec_read_fd(fd, 4, NULL);
+    TEST_CHECK(vec && cvec_get_sz(vec) == 16 && memcmp(vec, payload, sizeof(payload)) == 0);
+    cvec_free(vec);
+    close(fd);
+
+    // A round trip larger than the first read chunk
+    uint64_t count = 3 << 18;
+    uint64_t* big  = (uint64_t*)cvec_reserve(count, sizeof(uint64_t), NULL);
+    for(uint64_t i = 0; i < count; i++)
+        big = (uint64_t*)cvec_push_back(big, &i);
+
+    FILE* file = tmpfile();
+    TEST_CHECK(file && cvec_write_fd(fileno(file), big));
+    lseek(fileno(file), 0, SEEK_SET);
+
+    uint64_t* back = (uint64_t*)cvec_read_fd(fileno(file), sizeof(uint64_t), NULL);
+    TEST_CHECK(back && cvec_get_sz(back) == count && memcmp(back, big, count * sizeof(uint64_t)) == 0);
+
+    cvec_free(back);
+    cvec_free(big);
+    fclose(file);
+}
+
+// cvec_append_fd with a count larger than the descriptor holds
+static void test_append_fd_count(void)
+{
+    uint8_t payload[100];
+    memset(payload, 0x7f, sizeof(payload));
+
+    FILE* file = tmpfile();
+    TEST_CHECK(file && write(fileno(file), payload, sizeof(payload)) == (ssize_t)sizeof(payload));
+    lseek(fileno(file), 0, SEEK_SET);
+
+    uint8_t* vec = (uint8_t*)cvec_create(1, NULL);
+    TEST_CHECK(cvec_append_fd(&vec, fileno(file), UINT64_MAX - 1) == 0);
+    TEST_CHECK(cvec_append_fd(&vec, fileno(file), (uint64_t)1 << 40) == sizeof(payload));
+    TEST_CHECK(cvec_get_sz(vec) == sizeof(payload) && vec[99] == 0x7f);
+
+    cvec_free(vec);
+    fclose(file);
+}
+
+
+// Deque linearize for every head and size of small rings, and the generic
+// mutators refusing a ring
+
+static void test_deque_elem(uint8_t* elem, uint64_t elem_sz, uint64_t value)
+{
+    for(uint64_t j = 0; j < elem_sz; j++)
+        elem[j] = (uint8_t)(value * 31 + j);
+}
+
+static void test_deque_linearize(void)
+{
+    static const uint64_t sizes[] = { 1, 3, 8, 24, 300 };
+    uint8_t elem[300];
+    uint8_t want[300];
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for(uint64_t cap = 1; cap <= 13; cap++)
+    for(uint64_t head = 0; head < cap; head++)
+    for(uint64_t size = 1; size <= cap; size++)
+    {
+        uint64_t elem_sz = sizes[s];
+
+        uint8_t* vec = (uint8_t*)cvec_deque_reserve(cap, elem_sz, NULL);
+        TEST_CHECK(vec != NULL);
+        if(!vec || cvec_get_capacity(vec) != cap)
+        {
+            TEST_CHECK(vec && cvec_get_capacity(vec) == cap);
+            cvec_free(vec);
+            continue;
+        }
+
+        // head + 1 pushes then head pops leave the front at slot head
+        for(uint64_t i = 0; i < head + size; i++)
+        {
+            test_deque_elem(elem, elem_sz, i);
+            vec = (uint8_t*)cvec_deque_push_back(vec, elem);
+            if(i < head)
+                cvec_deque_pop_front(vec, NULL);
+        }
+
+        TEST_CHECK(cvec_get_sz(vec) == size && cvec_get_capacity(vec) == cap);
+
+        vec = (uint8_t*)cvec_deque_linearize(vec);
+
+        int32_t ordered = 1;
+        for(uint64_t i = 0; i < size; i++)
+        {
+            test_deque_elem(want, elem_sz, head + i);
+            ordered = ordered && memcmp(vec + i * elem_sz, want, elem_sz) == 0;
+        }
+
+        TEST_CHECK(ordered);
+        TEST_CHECK(cvec_get_sz(vec) == size);
+
+        // A plain vector again
+        vec = (uint8_t*)cvec_push_back(vec, elem);
+        TEST_CHECK(vec != NULL && cvec_get_sz(vec) == size + 1);
+
+        cvec_free(vec);
+    }
+}
+
+static void test_deque_reject(void)
+{
+    uint64_t value = 1;
+
+    uint64_t* deque = (uint64_t*)cvec_deque_reserve(4, sizeof(uint64_t), NULL);
+    uint64_t* plain = (uint64_t*)cvec_create(sizeof(uint64_t), NULL);
+    TEST_CHECK(deque && plain);
+
+    // Wrap the ring: front at slot 3, back at slot 0
+    for(uint64_t i = 0; i < 4; i++)
+        deque = (uint64_t*)cvec_deque_push_back(deque, &i);
+    for(uint64_t i = 0; i < 3; i++)
+        cvec_deque_pop_front(deque, NULL);
+    deque = (uint64_t*)cvec_deque_push_back(deque, &value);
+
+    plain = (uint64_t*)cvec_push_back(plain, &value);
+
+    TEST_CHECK(cvec_grow(deque, 100) == NULL);
+    TEST_CHECK(cvec_resize(deque, 10, NULL) == NULL);
+    TEST_CHECK(cvec_push_back(deque, &value) == NULL);
+    TEST_CHECK(cvec_push_back_n(deque, &value, 1) == NULL);
+    TEST_CHECK(cvec_emplace_back_n(&deque, 1) == NULL);
+    TEST_CHECK(cvec_insert(deque, 0, &value) == NULL);
+    TEST_CHECK(cvec_splice(deque, 0, plain, 0, 1) == NULL);
+    TEST_CHECK(cvec_splice(plain, 0, deque, 0, 1) == NULL);
+    TEST_CHECK(cvec_release(deque, 0) == deque);
+
+    cvec_erase(deque, 0);
+    cvec_erase_unordered(deque, 0);
+    cvec_erase_range(deque, 0, 2);
+
+    FILE* file = tmpfile();
+    TEST_CHECK(file && cvec_write_fd(fileno(file), deque) == 0);
+    TEST_CHECK(file && cvec_append_fd(&deque, fileno(file), 1) == 0);
+    if(file) fclose(file);
+
+    TEST_CHECK(cvec_get_sz(deque) == 2 && cvec_get_capacity(deque) == 4);
+    TEST_CHECK(cvec_get_sz(plain) == 1);
+    TEST_CHECK(*(uint64_t*)cvec_deque_at(deque, 0) == 3 && *(uint64_t*)cvec_deque_at(deque, 1) == 1);
+
+    cvec_free(deque);
+    cvec_free(plain);
+}
+
+
+// Delta encoders refuse vectors whose element size is not their type
+
+static void test_delta_typesize(void)
+{
+    uint16_t* narrow = (uint16_t*)cvec_reserve(8, sizeof(uint16_t), NULL);
+    uint64_t* wide   = (uint64_t*)cvec_reserve(8, sizeof(uint64_t), NULL);
+    TEST_CHECK(narrow && wide);
+
+    for(uint64_t i = 0; i < 8; i++)
+    {
+        uint16_t n = (uint16_t)(i * 3);
+        uint64_t w = i * 1000;
+        narrow = (uint16_t*)cvec_push_back(narrow, &n);
+        wide   = (uint64_t*)cvec_push_back(wide, &w);
+    }
+
+    TEST_CHECK(cvec_delta_encode_i32((const int32_t*)narrow) == NULL);
+    TEST_CHECK(cvec_delta_encode_u32((const uint32_t*)narrow) == NULL);
+    TEST_CHECK(cvec_delta_encode_i64((const int64_t*)narrow) == NULL);
+    TEST_CHECK(cvec_delta_encode_u64((const uint64_t*)narrow) == NULL);
+    TEST_CHECK(cvec_delta_encode_u32((const uint32_t*)wide) == NULL);
+
+    uint8_t* enc = cvec_delta_encode_u64(wide);
+    TEST_CHECK(enc != NULL);
+
+    uint64_t* dec = enc ? cvec_delta_decode_u64(enc, cvec_get_sz(enc)) : NULL;
+    TEST_CHECK(dec && cvec_get_sz(dec) == 8 && memcmp(dec, wide, 8 * sizeof(uint64_t)) == 0);
+
+    cvec_free(dec);
+    cvec_free(enc);
+    cvec_free(narrow);
+    cvec_free(wide);
+}
+
+
+#if defined(CVEC_HAS_MMAP)
+// Writes len bytes to a fresh temporary file, path receives its name
+static int test_write_file(char* path, const void* bytes, size_t len)
+{
+    strcpy(path, "/tmp/cvec_test_XXXXXX");
+
+    int fd = mkstemp(path);
+    if(fd < 0)
+        return 0;
+
+    int32_t ok = write(fd, bytes, len) == (ssize_t)len;
+    close(fd);
+
+    return ok;
+}
+
+// cvec_map_file on valid files and on crafted stamps and metadata
+static void test_file_headers(void)
+{
+    char path[32];
+
+    // A valid file: create, grow, reopen read-only
+    TEST_CHECK(test_write_file(path, "", 0));
+
+    int32_t* vec = (int32_t*)cvec_map_file(path, sizeof(int32_t), CVEC_MAP_CREATE);
+    TEST_CHECK(vec != NULL);
+    for(int32_t i = 0; i < 100000 && vec; i++)
+        vec = (int32_t*)cvec_push_back(vec, &i);
+    TEST_CHECK(vec && cvec_get_sz(vec) == 100000);
+    cvec_free(vec);
+
+    vec = (int32_t*)cvec_map_file(path, sizeof(int32_t), CVEC_MAP_READONLY);
+    TEST_CHECK(vec && cvec_get_sz(vec) == 100000 && vec[99999] == 99999);
+
+    int32_t extra = 1;
+    TEST_CHECK(cvec_push_back(vec, &extra) == NULL);
+    cvec_free(vec);
+
+    TEST_CHECK(cvec_map_file(path, sizeof(int64_t), CVEC_MAP_READONLY) == NULL);
+
+    // Keep the valid image and corrupt one field at a time
+    FILE* file = fopen(path, "rb");
+    TEST_CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    size_t len = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* image = (uint8_t*)malloc(len);
+    TEST_CHECK(image && fread(image, 1, len, file) == len);
+    fclose(file);
+    unlink(path);
+
+    cvec_file_header stamp;
+    memcpy(&stamp, image, sizeof(stamp));
+
+    uint64_t meta_at = stamp.data_offset - sizeof(internal_cvec_metadata_);
+
+    for(int32_t corrupt = 0; corrupt < 11; corrupt++)
+    {
+        uint8_t* bad = (uint8_t*)malloc(len);
+        memcpy(bad, image, len);
+
+        cvec_file_header*        header = (cvec_file_header*)bad;
+        internal_cvec_metadata_* meta   = (internal_cvec_metadata_*)(bad + meta_at);
+        size_t                   bad_len = len;
+
+        switch(corrupt)
+        {
+            case 0:  header->magic[0] ^= 1;                           break;
+            case 1:  header->version++;                               break;
+            case 2:  header->endian = 0x04030201u;                    break;
+            case 3:  header->meta_size += 16;                         break;
+            case 4:  header->data_offset = UINT64_MAX;                break;
+            case 5:  header->data_offset = len + 4096;                break;
+            case 6:  header->data_offset += 4;                        break;
+            case 7:  meta->typesize = 0;                              break;
+            case 8:  meta->size = meta->capacity + 1;                 break;
+            case 9:  meta->capacity = UINT64_MAX / 4;                 break;
+            default: bad_len = sizeof(cvec_file_header) + 8;          break;
+        }
+
+        TEST_CHECK(test_write_file(path, bad, bad_len));
+        TEST_CHECK(cvec_map_file(path, 0, CVEC_MAP_READONLY) == NULL);
+        TEST_CHECK(cvec_map_file(path, 0, CVEC_MAP_WRITE) == NULL);
+        unlink(path);
+
+        free(bad);
+    }
+
+    free(image);
+}
+#endif
+
+
+#if defined(CVEC_ENABLE_THREADS)
+#define TEST_CONC_THREADS 8
+#define TEST_CONC_PUSHES  50000
+
+typedef struct
+{
+    cvec_conc* vec;
+    uint64_t   id;
+    int32_t    failed;
+} test_conc_producer;
+
+static void* test_conc_produce(void* arg)
+{
+    test_conc_producer* producer = (test_conc_producer*)arg;
+
+    for(uint64_t i = 0; i < TEST_CONC_PUSHES; i++)
+    {
+        // Thread id in the high bits, sequence number in the low bits
+        uint64_t value = (producer->id << 32) | i;
+
+        uint64_t index = cvec_conc_push_back(producer->vec, &value);
+        if(index == CVEC_NPOS || *(uint64_t*)cvec_conc_at(producer->vec, index) != value)
+            producer->failed = 1;
+    }
+
+    return NULL;
+}
+
+static uint64_t test_conc_destroyed;
+
+static void test_conc_destroy(void* elem)
+{
+    (void)elem;
+    test_conc_destroyed++;
+}
+
+// Several producers pushing at once: every value lands exactly once and
+// stays where it was written
+static void test_conc_push(void)
+{
+    cvec_conc vec;
+    cvec_conc_init(&vec, sizeof(uint64_t), test_conc_destroy);
+
+    pthread_t          threads[TEST_CONC_THREADS];
+    test_conc_producer producers[TEST_CONC_THREADS];
+
+    for(uint64_t t = 0; t < TEST_CONC_THREADS; t++)
+    {
+        producers[t].vec    = &vec;
+        producers[t].id     = t;
+        producers[t].failed = 0;
+        TEST_CHECK(pthread_create(&threads[t], NULL, test_conc_produce, &producers[t]) == 0);
+    }
+
+    for(uint64_t t = 0; t < TEST_CONC_THREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+        TEST_CHECK(!producers[t].failed);
+    }
+
+    uint64_t total = (uint64_t)TEST_CONC_THREADS * TEST_CONC_PUSHES;
+    TEST_CHECK(cvec_conc_get_sz(&vec) == total);
+
+    // Per thread the sequence numbers must show up in push order
+    uint64_t next[TEST_CONC_THREADS] = { 0 };
+    int32_t  ordered = 1;
+
+    for(uint64_t i = 0; i < total; i++)
+    {
+        uint64_t* value = (uint64_t*)cvec_conc_at(&vec, i);
+        if(!value || (*value >> 32) >= TEST_CONC_THREADS)
+        {
+            ordered = 0;
+            break;
+        }
+
+        uint64_t t = *value >> 32;
+        ordered = ordered && (*value & 0xffffffffu) == next[t];
+        next[t]++;
+    }
+
+    TEST_CHECK(ordered);
+    TEST_CHECK(cvec_conc_at(&vec, total) == NULL);
+
+    test_conc_destroyed = 0;
+    cvec_conc_free(&vec);
+    TEST_CHECK(test_conc_destroyed == total && cvec_conc_get_sz(&vec) == 0);
+}
+
+// Parallel chunks start on 64 byte offsets from the data pointer and cover
+// every element exactly once, for element sizes that do not divide 64
+
+typedef struct
+{
+    const uint8_t* base;
+    uint64_t       elem_sz;
+    int32_t        misaligned;
+} test_par_ctx;
+
+static void test_par_mark(void* first, uint64_t count, void* ctx)
+{
+    test_par_ctx* par = (test_par_ctx*)ctx;
+
+    if(((const uint8_t*)first - par->base) % 64 != 0)
+        par->misaligned = 1;
+
+    for(uint64_t i = 0; i < count; i++)
+        ((uint8_t*)first)[i * par->elem_sz] += 1;
+}
+
+static void test_par_chunks(void)
+{
+    static const uint64_t sizes[] = { 1, 3, 12, 24, 100, 4096 };
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint64_t elem_sz = sizes[s];
+        uint64_t count   = (3 * CVEC_PAR_CHUNK_BYTES) / elem_sz + 7;
+
+        uint8_t* vec = (uint8_t*)cvec_reserve(count, elem_sz, NULL);
+        TEST_CHECK(vec != NULL);
+        if(!vec) continue;
+
+        uint8_t* zero = (uint8_t*)calloc(1, elem_sz);
+        vec = (uint8_t*)cvec_resize(vec, count, zero);
+        free(zero);
+        TEST_CHECK(vec != NULL);
+        if(!vec) continue;
+
+        test_par_ctx par = { vec, elem_sz, 0 };
+        cvec_par_transform(vec, test_par_mark, &par, NULL);
+
+        int32_t once = 1;
+        for(uint64_t i = 0; i < count; i++)
+            once = once && vec[i * elem_sz] == 1;
+
+        TEST_CHECK(!par.misaligned);
+        TEST_CHECK(once);
+
+        cvec_free(vec);
+    }
+}
+#endif
+
+
+int main(void)
+{
+    test_size_limits();
+#if defined(CVEC_HAS_MMAP)
+    test_mmap_growth();
+    test_file_headers();
+#endif
+#if defined(CVEC_ENABLE_THREADS)
+    test_conc_push();
+    test_par_chunks();
+#endif
+    test_stream_headers();
+    test_append_fd_count();
+    test_deque_linearize();
+    test_deque_reject();
+    test_delta_typesize();
+
+    if(test_failures)
+        fprintf(stderr, "%d check(s) failed\n", test_failures);
+    else
+        printf("all tests passed\n");
+
+    return test_failures;
+}